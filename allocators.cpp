@@ -0,0 +1,193 @@
+#include "allocators.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace std;
+
+static FrameArena* arenas[ALLOC_MAX_REGISTERED];
+static Pool* pools[ALLOC_MAX_REGISTERED];
+
+template<class T> static void registerAllocator(T** table, T* allocator, bool add)
+{
+	for(int i = 0; i < ALLOC_MAX_REGISTERED; i++){
+		if(add && table[i] == 0){
+			table[i] = allocator;
+			return;
+		}
+		if(!add && table[i] == allocator){
+			table[i] = 0;
+			return;
+		}
+	}
+}
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//Over-allocates and keeps the malloc pointer just below the aligned block
+void* alignedAllocate(size_t size, size_t alignment)
+{
+	unsigned char* raw = (unsigned char*)malloc(size + alignment + sizeof(void*));
+	if(raw == 0)
+		return 0;
+	uintptr_t aligned = alignUp((uintptr_t)(raw + sizeof(void*)), alignment);
+	((void**)aligned)[-1] = raw;
+	return (void*)aligned;
+}
+
+void alignedFree(void* p)
+{
+	if(p)
+		free(((void**)p)[-1]);
+}
+
+// --------------------------------------------------------------------------
+
+FrameArena::FrameArena():	name(""),
+							base(0),
+							capacity(0),
+							head(0),
+							highWater(0),
+							failed(0)
+{}
+
+bool FrameArena::init(const char* _name, size_t _capacity)
+{
+	name = _name;
+	capacity = _capacity;
+	head = highWater = 0;
+	failed = 0;
+	base = (unsigned char*)alignedAllocate(capacity, ALLOC_SIMD_ALIGN);
+	if(base == 0)
+		return false;
+	registerAllocator(arenas, this, true);
+	return true;
+}
+
+void FrameArena::destroy()
+{
+	registerAllocator(arenas, this, false);
+	alignedFree(base);
+	base = 0;
+	capacity = head = 0;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+	size_t start = alignUp(head, alignment);
+	if(base == 0 || start + size > capacity){
+		failed++;
+		return 0;
+	}
+	head = start + size;
+	if(head > highWater)
+		highWater = head;
+	return base + start;
+}
+
+void FrameArena::reset()
+{
+	head = 0;
+}
+
+// --------------------------------------------------------------------------
+
+Pool::Pool():	name(""),
+				slotSize(0),
+				alignment(ALLOC_SIMD_ALIGN),
+				slotsPerSlab(0),
+				slabs(0),
+				freeList(0),
+				slabCount(0),
+				live(0),
+				highWater(0)
+{}
+
+bool Pool::init(const char* _name, size_t _slotSize, size_t _alignment, int _slotsPerSlab)
+{
+	name = _name;
+	alignment = (_alignment < sizeof(void*)) ? sizeof(void*) : _alignment;
+	slotSize = alignUp((_slotSize < sizeof(void*)) ? sizeof(void*) : _slotSize, alignment);
+	slotsPerSlab = (_slotsPerSlab < 1) ? 1 : _slotsPerSlab;
+	live = highWater = 0;
+	registerAllocator(pools, this, true);
+	return addSlab();
+}
+
+//Slot 0 of each slab links the slabs together; the rest go on the free list
+bool Pool::addSlab()
+{
+	unsigned char* slab = (unsigned char*)alignedAllocate(slotSize*(slotsPerSlab + 1), alignment);
+	if(slab == 0)
+		return false;
+	*(void**)slab = slabs;
+	slabs = slab;
+	slabCount++;
+
+	for(int i = slotsPerSlab; i >= 1; i--){
+		void* slot = slab + i*slotSize;
+		*(void**)slot = freeList;
+		freeList = slot;
+	}
+	return true;
+}
+
+void Pool::destroy()
+{
+	registerAllocator(pools, this, false);
+	while(slabs){
+		void* next = *(void**)slabs;
+		alignedFree(slabs);
+		slabs = next;
+	}
+	freeList = 0;
+	slabCount = live = 0;
+}
+
+void* Pool::allocate()
+{
+	if(freeList == 0 && !addSlab())
+		return 0;
+	void* slot = freeList;
+	freeList = *(void**)slot;
+	live++;
+	if(live > highWater)
+		highWater = live;
+	return slot;
+}
+
+void Pool::release(void* slot)
+{
+	if(slot == 0)
+		return;
+	*(void**)slot = freeList;
+	freeList = slot;
+	live--;
+}
+
+// --------------------------------------------------------------------------
+
+void printMemoryReport()
+{
+	printf("Memory:\n");
+	for(int i = 0; i < ALLOC_MAX_REGISTERED; i++){
+		FrameArena* a = arenas[i];
+		if(a == 0)
+			continue;
+		printf("  arena %-10s %8.1f KB reserved, peak %8.1f KB", a->name, a->capacity/1024.0, a->highWater/1024.0);
+		if(a->failed)
+			printf(", %d allocations refused", a->failed);
+		printf("\n");
+	}
+	for(int i = 0; i < ALLOC_MAX_REGISTERED; i++){
+		Pool* p = pools[i];
+		if(p == 0)
+			continue;
+		printf("  pool  %-10s %8.1f KB reserved, %d of %d slots live (peak %d), %zu-byte slots aligned to %zu\n",
+				p->name, p->slabCount*(p->slotsPerSlab + 1)*p->slotSize/1024.0,
+				p->live, p->slabCount*p->slotsPerSlab, p->highWater, p->slotSize, p->alignment);
+	}
+}
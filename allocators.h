@@ -0,0 +1,90 @@
+#ifndef ALLOCATORS_H
+#define ALLOCATORS_H
+
+#include <cstddef>
+#include <new>
+
+#define ALLOC_SIMD_ALIGN 32			//Enough for AVX loads of anything carved out here
+#define ALLOC_MAX_REGISTERED 16		//Arenas plus pools that printMemoryReport() lists
+
+//Aligned blocks straight from the heap; every allocator below gets its memory here
+void* alignedAllocate(size_t size, size_t alignment);
+void alignedFree(void* p);
+
+/*
+	Linear allocator for data that only lives until the end of the frame:
+	allocation bumps a pointer and reset() throws everything away at once.
+	Plain data only; nothing is constructed or destroyed. Returns 0 when
+	full, like StreamBuffer::allocate, and highWater says how big it needs to be.
+*/
+class FrameArena{
+public:
+	const char* name;
+	unsigned char* base;
+	size_t capacity;
+	size_t head;
+	size_t highWater;
+	int failed;			//Allocations refused since init()
+
+	FrameArena();
+
+	bool init(const char* _name, size_t _capacity);
+	void destroy();
+
+	void* allocate(size_t size, size_t alignment = ALLOC_SIMD_ALIGN);
+	void reset();
+
+	template<class T> T* allocate(size_t count)
+	{
+		return (T*)allocate(count*sizeof(T), (alignof(T) > ALLOC_SIMD_ALIGN) ? alignof(T) : ALLOC_SIMD_ALIGN);
+	}
+};
+
+/*
+	Fixed-size slots carved from slabs, with released slots kept on a free
+	list for the next allocation. Every slot is the same size, so records
+	can come and go in any order without fragmenting anything; slabs are
+	only returned in destroy().
+*/
+class Pool{
+public:
+	const char* name;
+	size_t slotSize;		//Rounded up to the alignment
+	size_t alignment;
+	int slotsPerSlab;
+	void* slabs;			//Singly linked through each slab's first slot
+	void* freeList;
+	int slabCount;
+	int live;
+	int highWater;
+
+	Pool();
+
+	bool init(const char* _name, size_t _slotSize, size_t _alignment, int _slotsPerSlab);
+	void destroy();
+
+	void* allocate();
+	void release(void* slot);
+
+	template<class T> T* create()
+	{
+		void* slot = allocate();
+		return slot ? new(slot) T() : 0;
+	}
+
+	template<class T> void destroy(T* object)
+	{
+		if(object == 0)
+			return;
+		object->~T();
+		release(object);
+	}
+
+private:
+	bool addSlab();
+};
+
+//Every initialized arena and pool, with its current and peak use
+void printMemoryReport();
+
+#endif
@@ -0,0 +1,132 @@
+#include "alloctracker.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+AllocationTracker allocations;
+thread_local const char* allocationZone = 0;
+
+//Zones are claimed by name pointer; PROFILE_ZONE names are string literals
+AllocationZone& AllocationTracker::zone(const char* name)
+{
+	if(name == 0)
+		return zones[ALLOC_MAX_ZONES];
+	for(int i = 0; i < ALLOC_MAX_ZONES; i++){
+		const char* current = zones[i].name.load(memory_order_acquire);
+		if(current == name)
+			return zones[i];
+		if(current == 0){
+			const char* expected = 0;
+			if(zones[i].name.compare_exchange_strong(expected, name) || expected == name)
+				return zones[i];
+		}
+	}
+	return zones[ALLOC_MAX_ZONES];
+}
+
+void AllocationTracker::record(size_t size)
+{
+	count.fetch_add(1, memory_order_relaxed);
+	bytes.fetch_add(size, memory_order_relaxed);
+	AllocationZone& z = zone(allocationZone);
+	z.count.fetch_add(1, memory_order_relaxed);
+	z.bytes.fetch_add(size, memory_order_relaxed);
+}
+
+//Call once per pass of the loop, drawn or idle, from the thread that runs it
+void AllocationTracker::endFrame()
+{
+#ifdef TRACK_ALLOCATIONS
+	unsigned long long totalCount = count.load(memory_order_relaxed);
+	unsigned long long totalBytes = bytes.load(memory_order_relaxed);
+
+	if(frames >= ALLOC_WARMUP && totalCount != frameCount){
+		allocatingFrames++;
+		steadyCount += totalCount - frameCount;
+		if(allocatingFrames <= ALLOC_MAX_REPORTS){
+			printf("Allocations: frame %d made %llu (%llu bytes):", frames,
+					totalCount - frameCount, totalBytes - frameBytes);
+			for(int i = 0; i <= ALLOC_MAX_ZONES; i++){
+				unsigned long long n = zones[i].count.load(memory_order_relaxed);
+				if(n != zoneCounts[i]){
+					const char* name = zones[i].name.load(memory_order_relaxed);
+					printf(" %s %llu", name ? name : "(untagged)", n - zoneCounts[i]);
+				}
+			}
+			printf("\n");
+		}
+	}
+
+	frameCount = totalCount;
+	frameBytes = totalBytes;
+	for(int i = 0; i <= ALLOC_MAX_ZONES; i++)
+		zoneCounts[i] = zones[i].count.load(memory_order_relaxed);
+	frames++;
+#endif
+}
+
+void AllocationTracker::report()
+{
+#ifdef TRACK_ALLOCATIONS
+	printf("Allocations: %llu (%llu bytes) in total; %d of %d frames after warm-up allocated, %llu allocations\n",
+			count.load(), bytes.load(), allocatingFrames, (frames > ALLOC_WARMUP) ? frames - ALLOC_WARMUP : 0, steadyCount);
+	for(int i = 0; i <= ALLOC_MAX_ZONES; i++){
+		unsigned long long n = zones[i].count.load();
+		if(n == 0)
+			continue;
+		const char* name = zones[i].name.load();
+		printf("  %-16s %10llu %14llu bytes\n", name ? name : "(untagged)", n, zones[i].bytes.load());
+	}
+#endif
+}
+
+#ifdef TRACK_ALLOCATIONS
+//Replacements for the global allocation functions; malloc calls made by C
+//libraries (stb, FreeType, the GL driver) are not seen
+void* operator new(size_t size)
+{
+	allocations.record(size);
+	void* p = malloc(size ? size : 1);
+	if(p == 0)
+		throw bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	allocations.record(size);
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	return operator new(size, nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+#endif
@@ -0,0 +1,53 @@
+#ifndef ALLOCTRACKER_H
+#define ALLOCTRACKER_H
+
+#include <atomic>
+#include <cstddef>
+
+#define ALLOC_MAX_ZONES 64
+#define ALLOC_WARMUP 60			//Frames before the loop is expected to stop allocating
+#define ALLOC_MAX_REPORTS 10	//Offending frames printed before going quiet
+
+struct AllocationZone{
+	std::atomic<const char*> name;
+	std::atomic<unsigned long long> count;
+	std::atomic<unsigned long long> bytes;
+};
+
+/*
+	Counts heap allocations per frame and per subsystem. Built with
+	TRACK_ALLOCATIONS, global operator new/delete are replaced to call
+	record(), and each PROFILE_ZONE names the subsystem its allocations are
+	charged to. After the warm-up every frame should read zero; endFrame()
+	prints the zones behind any frame that doesn't.
+
+	Without TRACK_ALLOCATIONS nothing is counted and all of this is a no-op.
+	No constructor: the counters are zero-initialized before any static
+	constructor gets a chance to allocate.
+*/
+class AllocationTracker{
+public:
+	std::atomic<unsigned long long> count;
+	std::atomic<unsigned long long> bytes;
+	AllocationZone zones[ALLOC_MAX_ZONES + 1];		//Last one collects overflow and untagged allocations
+
+	unsigned long long frameCount, frameBytes;		//Totals when the frame began
+	unsigned long long zoneCounts[ALLOC_MAX_ZONES + 1];
+	int frames;
+	int allocatingFrames;		//After warm-up
+	unsigned long long steadyCount;
+
+	void record(size_t size);
+	void endFrame();
+	void report();
+
+private:
+	AllocationZone& zone(const char* name);
+};
+
+extern AllocationTracker allocations;
+
+//Subsystem the calling thread is in, kept by ProfileZone
+extern thread_local const char* allocationZone;
+
+#endif
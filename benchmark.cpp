@@ -0,0 +1,353 @@
+#include "benchmark.h"
+#include "stb_image.h"
+#include "stb_image_write.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static BenchmarkAction nothing()
+{
+	BenchmarkAction action = {false, 0, vec3(0.f)};
+	return action;
+}
+
+//Camera circling the Sun while the system runs at the fastest time warp
+static BenchmarkAction sunOrbit(int frame)
+{
+	BenchmarkAction action = nothing();
+	action.reset = frame == 0;
+	if(frame >= 1 && frame <= 5)
+		action.key = GLFW_KEY_UP;
+	action.cameraDelta = vec3(0.f, 0.05f, 0.f);
+	return action;
+}
+
+//Glide to the Moon, then zoom in until the minimum radius clamps
+static BenchmarkAction moonZoom(int frame)
+{
+	BenchmarkAction action = nothing();
+	action.reset = frame == 0;
+	if(frame == 1)
+		action.key = GLFW_KEY_3;
+	if(frame > BENCH_WARMUP)
+		action.cameraDelta = vec3(0.f, 0.f, -0.05f);
+	return action;
+}
+
+//Hop Earth, Moon, Sun and round again, mid-transition most of the time
+static BenchmarkAction focusCycle(int frame)
+{
+	const int keys[3] = {GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_1};
+	BenchmarkAction action = nothing();
+	action.reset = frame == 0;
+	if(frame % 45 == 1)
+		action.key = keys[(frame/45) % 3];
+	return action;
+}
+
+//Paused system and a still camera: the cost of drawing alone
+static BenchmarkAction paused(int frame)
+{
+	BenchmarkAction action = nothing();
+	action.reset = frame == 0;
+	if(frame == 1)
+		action.key = GLFW_KEY_SPACE;
+	return action;
+}
+
+static const Scenario scenarioTable[] = {
+	{"sun-orbit", 250, sunOrbit},
+	{"moon-zoom", 250, moonZoom},
+	{"focus-cycle", 280, focusCycle},
+	{"paused", 130, paused},
+};
+static const int scenarioCount = sizeof(scenarioTable)/sizeof(scenarioTable[0]);
+
+Benchmark::Benchmark():	current(0),
+						frame(0),
+						lastFrameEnd(0.0),
+						referenceDir(0),
+						updateReferences(false),
+						nextQuery(0),
+						timing(false)
+{}
+
+//Picks the scenarios to run, all of them when only is 0 or "all"
+bool Benchmark::init(const char* only, const char* _referenceDir, bool _updateReferences)
+{
+	referenceDir = _referenceDir;
+	updateReferences = _updateReferences;
+	if(updateReferences){
+#ifdef _WIN32
+		bool made = _mkdir(referenceDir) == 0 || errno == EEXIST;
+#else
+		bool made = mkdir(referenceDir, 0755) == 0 || errno == EEXIST;
+#endif
+		if(!made){
+			printf("Benchmark: can't create reference directory %s\n", referenceDir);
+			return false;
+		}
+	}
+	for(int i = 0; i < scenarioCount; i++){
+		if(only == 0 || strcmp(only, "all") == 0 || strcmp(only, scenarioTable[i].name) == 0)
+			scenarios.push_back(i);
+	}
+	if(scenarios.empty()){
+		printf("Benchmark: no scenario called %s; have", only);
+		for(int i = 0; i < scenarioCount; i++)
+			printf(" %s", scenarioTable[i].name);
+		printf("\n");
+		return false;
+	}
+	results.resize(scenarios.size());
+
+	//Reserved up front so recording a frame never touches the heap
+	for(unsigned i = 0; i < scenarios.size(); i++){
+		int frames = scenarioTable[scenarios[i]].frames;
+		results[i].frameTimes.reserve(frames);
+		results[i].cpuTimes.reserve(frames);
+		results[i].gpuTimes.reserve(frames);
+	}
+
+	for(int i = 0; i < BENCH_QUERIES; i++){
+		glGenQueries(2, queries[i]);
+		queryScenario[i] = -1;
+	}
+	return true;
+}
+
+void Benchmark::destroy()
+{
+	for(int i = 0; i < BENCH_QUERIES; i++)
+		glDeleteQueries(2, queries[i]);
+}
+
+bool Benchmark::done()
+{
+	return current >= (int)scenarios.size();
+}
+
+BenchmarkAction Benchmark::action()
+{
+	return scenarioTable[scenarios[current]].step(frame);
+}
+
+//Whole-frame GPU time from a GL_TIMESTAMP pair, so it can't collide with
+//any GL_TIME_ELAPSED query the frame itself uses
+void Benchmark::gpuBegin()
+{
+	if(queryScenario[nextQuery] >= 0)
+		collectGPU(false);
+	timing = queryScenario[nextQuery] < 0 && frame >= BENCH_WARMUP;
+	if(timing)
+		glQueryCounter(queries[nextQuery][0], GL_TIMESTAMP);
+}
+
+void Benchmark::gpuEnd()
+{
+	if(!timing)
+		return;
+	glQueryCounter(queries[nextQuery][1], GL_TIMESTAMP);
+	queryScenario[nextQuery] = current;
+	nextQuery = (nextQuery + 1) % BENCH_QUERIES;
+}
+
+void Benchmark::collectGPU(bool wait)
+{
+	for(int i = 1; i <= BENCH_QUERIES; i++){
+		int q = (nextQuery + i) % BENCH_QUERIES;		//Oldest first
+		if(queryScenario[q] < 0)
+			continue;
+
+		GLint available = 0;
+		if(!wait){
+			glGetQueryObjectiv(queries[q][1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if(!available)
+				return;
+		}
+
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(queries[q][0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(queries[q][1], GL_QUERY_RESULT, &end);
+		results[queryScenario[q]].gpuTimes.push_back((end - begin)*1e-9);
+		queryScenario[q] = -1;
+	}
+}
+
+//Records the finished frame; returns true when it was the last of its
+//scenario, which is the moment to capture() it
+bool Benchmark::endFrame(double cpuSeconds, double now)
+{
+	ScenarioResult& result = results[current];
+	if(frame >= BENCH_WARMUP){
+		result.cpuTimes.push_back(cpuSeconds);
+		if(lastFrameEnd > 0.0)
+			result.frameTimes.push_back(now - lastFrameEnd);
+	}
+	lastFrameEnd = now;
+
+	frame++;
+	if(frame < scenarioTable[scenarios[current]].frames)
+		return false;
+
+	frame = 0;
+	lastFrameEnd = 0.0;
+	current++;
+	return true;
+}
+
+//Saves the last frame of the scenario that just finished and compares it
+//with the reference image of the same name
+void Benchmark::capture(GLuint framebuffer, int width, int height)
+{
+	ScenarioResult& result = results[current - 1];
+	const char* name = scenarioTable[scenarios[current - 1]].name;
+
+	pixels.resize(width*height*3);
+	image.resize(pixels.size());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	//Flip to top-down rows, the way images are stored
+	for(int row = 0; row < height; row++)
+		memcpy(&image[row*width*3], &pixels[(height - 1 - row)*width*3], width*3);
+
+	snprintf(result.image, sizeof(result.image), "bench_%s.png", name);
+	stbi_write_png(result.image, width, height, 3, &image[0], width*3);
+
+	result.status = "missing";
+	result.meanError = 0.0;
+	result.maxError = 0;
+	result.changedPixels = 0.0;
+
+	char reference[512];
+	snprintf(reference, sizeof(reference), "%s/bench_%s.png", referenceDir, name);
+	if(updateReferences){
+		if(stbi_write_png(reference, width, height, 3, &image[0], width*3))
+			result.status = "updated";
+		else
+			printf("Benchmark: could not write reference %s\n", reference);
+		return;
+	}
+
+	//A missing reference fails the run: otherwise a wrong --reference would
+	//quietly pass anything
+	int refWidth, refHeight, refComponents;
+	unsigned char* expected = stbi_load(reference, &refWidth, &refHeight, &refComponents, 3);
+	if(expected == 0){
+		printf("Benchmark: no reference image %s; record one with --update-reference\n", reference);
+		return;
+	}
+	if(refWidth != width || refHeight != height){
+		result.status = "size-mismatch";
+		stbi_image_free(expected);
+		return;
+	}
+
+	long long total = 0;
+	int changed = 0;
+	for(int i = 0; i < width*height; i++){
+		int worst = 0;
+		for(int c = 0; c < 3; c++){
+			int difference = abs((int)image[i*3 + c] - (int)expected[i*3 + c]);
+			total += difference;
+			worst = std::max(worst, difference);
+		}
+		result.maxError = std::max(result.maxError, worst);
+		if(worst > BENCH_PIXEL_TOLERANCE)
+			changed++;
+	}
+	stbi_image_free(expected);
+
+	result.meanError = total/(double)(width*height*3);
+	result.changedPixels = changed/(double)(width*height);
+	result.status = (result.changedPixels > BENCH_CHANGED_LIMIT) ? "mismatch" : "match";
+}
+
+static TimingSummary summarize(vector<double> times)
+{
+	TimingSummary summary = {0.0, 0.0, 0.0, 0.0};
+	if(times.empty())
+		return summary;
+
+	sort(times.begin(), times.end());
+	double sum = 0.0;
+	for(unsigned i = 0; i < times.size(); i++)
+		sum += times[i];
+	summary.mean = sum/times.size()*1e3;
+	summary.p50 = times[(size_t)(0.50*(times.size() - 1) + 0.5)]*1e3;
+	summary.p95 = times[(size_t)(0.95*(times.size() - 1) + 0.5)]*1e3;
+	summary.p99 = times[(size_t)(0.99*(times.size() - 1) + 0.5)]*1e3;
+	return summary;
+}
+
+//False if any scenario's image no longer matches its reference, or has none
+bool Benchmark::passed()
+{
+	for(unsigned i = 0; i < results.size(); i++){
+		if(strcmp(results[i].status, "match") != 0 && strcmp(results[i].status, "updated") != 0)
+			return false;
+	}
+	return true;
+}
+
+static void writeSummary(FILE* file, const char* name, const TimingSummary& s)
+{
+	fprintf(file, "\"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}", name, s.mean, s.p50, s.p95, s.p99);
+}
+
+//Machine-readable results, plus a table on stdout
+bool Benchmark::writeResults(const char* filename, const char* renderer, int width, int height)
+{
+	collectGPU(true);
+	for(unsigned i = 0; i < results.size(); i++){
+		results[i].frame = summarize(results[i].frameTimes);
+		results[i].cpu = summarize(results[i].cpuTimes);
+		results[i].gpu = summarize(results[i].gpuTimes);
+	}
+
+	printf("%-12s %9s %9s %9s %9s %9s %9s  %s\n", "scenario", "mean ms", "p50", "p95", "p99", "cpu ms", "gpu ms", "image");
+	for(unsigned i = 0; i < results.size(); i++){
+		const ScenarioResult& r = results[i];
+		printf("%-12s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f  %s (mean error %.3f)\n", scenarioTable[scenarios[i]].name,
+				r.frame.mean, r.frame.p50, r.frame.p95, r.frame.p99, r.cpu.mean, r.gpu.mean, r.status, r.meanError);
+	}
+
+	FILE* file = fopen(filename, "w");
+	if(file == 0){
+		printf("Benchmark: could not write %s\n", filename);
+		return false;
+	}
+
+	fprintf(file, "{\n  \"renderer\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n  \"warmup_frames\": %d,\n  \"scenarios\": [",
+			renderer, width, height, BENCH_WARMUP);
+	for(unsigned i = 0; i < results.size(); i++){
+		const ScenarioResult& r = results[i];
+		fprintf(file, "%s\n    {\"name\": \"%s\", \"frames\": %d,\n     ", (i > 0) ? "," : "",
+				scenarioTable[scenarios[i]].name, (int)r.cpuTimes.size());
+		writeSummary(file, "frame_ms", r.frame);
+		fprintf(file, ",\n     ");
+		writeSummary(file, "cpu_ms", r.cpu);
+		fprintf(file, ",\n     ");
+		writeSummary(file, "gpu_ms", r.gpu);
+		fprintf(file, ",\n     \"image\": \"%s\", \"reference\": {\"status\": \"%s\", \"mean_error\": %.4f, \"max_error\": %d, \"changed_pixels\": %.6f}}",
+				r.image, r.status, r.meanError, r.maxError, r.changedPixels);
+	}
+	fprintf(file, "\n  ]\n}\n");
+	fclose(file);
+
+	printf("Benchmark: wrote %s\n", filename);
+	return true;
+}
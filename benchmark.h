@@ -0,0 +1,92 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include "glm/glm.hpp"
+
+using namespace glm;
+
+#define BENCH_WARMUP 10				//Frames per scenario left out of the statistics
+#define BENCH_QUERIES 4				//Frames of GPU timing in flight
+#define BENCH_PIXEL_TOLERANCE 16	//Channel difference that counts a pixel as changed
+#define BENCH_CHANGED_LIMIT 0.005	//Fraction of changed pixels that fails a comparison
+
+//What a scenario script does on one frame, applied by the main loop
+struct BenchmarkAction{
+	bool reset;				//Restore the initial scene, camera and speed
+	int key;				//Key pressed and released this frame, or 0
+	vec3 cameraDelta;		//Orbit phi, theta, radius
+};
+
+struct Scenario{
+	const char* name;
+	int frames;				//Including the warm-up
+	BenchmarkAction (*step)(int frame);
+};
+
+struct TimingSummary{
+	double mean, p50, p95, p99;		//Milliseconds
+};
+
+struct ScenarioResult{
+	std::vector<double> frameTimes, cpuTimes, gpuTimes;		//Seconds
+	TimingSummary frame, cpu, gpu;
+	char image[256];
+	const char* status;		//Reference comparison: match, mismatch, missing, size-mismatch or updated
+	double meanError;
+	int maxError;
+	double changedPixels;
+};
+
+/*
+	Runs the scripted scenarios back to back, one frame per main-loop
+	iteration, timing every frame after the warm-up. Camera transitions use
+	a fixed time step while benchmarking, so every run draws the same frames
+	and the last frame of each scenario can be compared with a reference.
+
+	action() -> frame drawn between gpuBegin()/gpuEnd() -> endFrame()
+	-> capture() when endFrame() says the scenario just finished
+*/
+class Benchmark{
+public:
+	std::vector<int> scenarios;		//Indices into the scenario table
+	std::vector<ScenarioResult> results;
+	int current;
+	int frame;
+	double lastFrameEnd;
+	const char* referenceDir;
+	bool updateReferences;			//Record this run's images as the references
+
+	GLuint queries[BENCH_QUERIES][2];
+	int queryScenario[BENCH_QUERIES];		//Owner of each pending pair, -1 if free
+	int nextQuery;
+	bool timing;
+
+	std::vector<unsigned char> pixels, image;		//Capture buffers, kept between scenarios
+
+	Benchmark();
+
+	bool init(const char* only, const char* _referenceDir, bool _updateReferences);
+	void destroy();
+
+	bool done();
+	BenchmarkAction action();
+
+	void gpuBegin();
+	void gpuEnd();
+	bool endFrame(double cpuSeconds, double now);
+	void capture(GLuint framebuffer, int width, int height);
+
+	bool passed();
+	bool writeResults(const char* filename, const char* renderer, int width, int height);
+
+private:
+	void collectGPU(bool wait);
+};
+
+#endif
@@ -23,16 +23,25 @@ mat4 rotateAbout(vec3 axis, float radians)
 Camera::Camera():	dir(vec3(0, 0, -1)), 
 					right(vec3(1, 0, 0)), 
 					up(vec3(0, 1, 0)),
-					pos(vec3(0,0,0)),
+					pos(dvec3(0,0,0)),
 					sphereCoords(vec3(0,0,0)), //azimuth, altitude, radius
-					atSphere(vec3(0,0,0)),
-					sphereRadius(0.f)
+					atSphere(dvec3(0,0,0)),
+					sphereRadius(0.f),
+					dirty(true),
+					transitioning(false),
+					captureStart(false),
+					transitionTime(0.0),
+					transitionDuration(0.0)
 {}
 
-Camera::Camera(vec3 _sphereCoords, vec3 _atSphere, float _sphereRadius):
+Camera::Camera(vec3 _sphereCoords, dvec3 _atSphere, float _sphereRadius):
 												sphereCoords(_sphereCoords),
 												atSphere(_atSphere),
-												sphereRadius(_sphereRadius)
+												sphereRadius(_sphereRadius),
+												transitioning(false),
+												captureStart(false),
+												transitionTime(0.0),
+												transitionDuration(0.0)
 {
 	updateThings();	
 }
@@ -46,12 +55,28 @@ void Camera::updateThings(){
 	else if (sphereCoords.z > 75){
 		sphereCoords.z = 75;
 	}
-	pos = sphereCoords.z * vec3(cos(theta) * sin(phi),
+	vec3 offset = sphereCoords.z * vec3(cos(theta) * sin(phi),
 						sin(theta) * sin(phi),
-						cos(phi)) + atSphere;
-	dir = normalize(pos - atSphere);
+						cos(phi));
+	pos = dvec3(offset) + atSphere;
+	dir = normalize(offset);
 	right = normalize(cross(dir, vec3(0, 0, 1)));
 	up =  normalize(cross(right, dir));
+
+	rotationMatrix = mat4(
+			vec4(right.x, up.x, -dir.x, 0),
+			vec4(right.y, up.y, -dir.y, 0),
+			vec4(right.z, up.z, -dir.z, 0),
+			vec4(0, 0, 0, 1));
+
+	mat4 translation = mat4 (
+			vec4(1, 0, 0, 0),
+			vec4(0, 1, 0, 0),
+			vec4(0, 0, 1, 0),
+			vec4(vec3(pos), 1));
+
+	viewMatrix = rotationMatrix*translation;
+	dirty = false;
 }
 
 /*
@@ -63,23 +88,93 @@ void Camera::updateThings(){
 
 mat4 Camera::getMatrix()
 {
-	mat4 cameraRotation = mat4(
-			vec4(right, 0),
-			vec4(up, 0),
-			vec4(-dir, 0),
-			vec4(0, 0, 0, 1));
+	if(dirty)
+		updateThings();
+	return viewMatrix;
+}
 
-	mat4 translation = mat4 (
-			vec4(1, 0, 0, 0),
-			vec4(0, 1, 0, 0),
-			vec4(0, 0, 1, 0),
-			vec4(pos, 1));
+/*
+	getMatrix() without the translation, i.e. the view from the eye placed
+	at the origin. Positions made relative to getEye() on the CPU, in double,
+	go through this with full float precision however far out the camera is.
+*/
+mat4 Camera::getRotationMatrix()
+{
+	if(dirty)
+		updateThings();
+	return rotationMatrix;
+}
 
-	return transpose(cameraRotation)*translation;
+//World position getMatrix() views from
+dvec3 Camera::getEye()
+{
+	if(dirty)
+		updateThings();
+	return -pos;
 }
 
 void Camera::moveCamera(float deltaPhi, float deltaTheta, float deltaRadius)
 {
 	sphereCoords += vec3(deltaPhi, deltaTheta, deltaRadius);
-	updateThings();
+	if(transitioning)
+		goalDistance += deltaRadius;
+	dirty = true;
+}
+
+//Follows the focus body; nothing is recomputed if it did not move
+void Camera::setTarget(dvec3 _atSphere, float _sphereRadius)
+{
+	//First target after startTransition(): remember where we were relative to it
+	if(captureStart){
+		startOffset = atSphere - _atSphere;
+		startSphereRadius = sphereRadius;
+		captureStart = false;
+	}
+
+	if(transitioning){
+		double t = transitionTime/transitionDuration;
+		float ease = (float)(t*t*(3.0 - 2.0*t));		//smoothstep
+		_atSphere += startOffset*(1.0 - ease);
+		_sphereRadius = mix(startSphereRadius, _sphereRadius, ease);
+		sphereCoords.z = mix(startDistance, goalDistance, ease);
+		dirty = true;
+	}
+
+	if(_atSphere != atSphere || _sphereRadius != sphereRadius){
+		atSphere = _atSphere;
+		sphereRadius = _sphereRadius;
+		dirty = true;
+	}
+}
+
+//Eases the camera onto the next setTarget() body over duration seconds,
+//ending goalDistance away from it
+void Camera::startTransition(float _goalDistance, double duration)
+{
+	transitioning = duration > 0.0;
+	captureStart = transitioning;
+	transitionTime = 0.0;
+	transitionDuration = duration;
+	startDistance = sphereCoords.z;
+	goalDistance = _goalDistance;
+
+	if(!transitioning){
+		sphereCoords.z = goalDistance;
+		dirty = true;
+	}
+}
+
+void Camera::update(double dt)
+{
+	if(!transitioning)
+		return;
+
+	transitionTime += dt;
+	if(transitionTime >= transitionDuration){
+		transitionTime = transitionDuration;
+		transitioning = false;
+		startOffset = dvec3(0.0);
+		sphereCoords.z = goalDistance;
+		dirty = true;
+	}
 }
\ No newline at end of file
@@ -5,24 +5,46 @@
 
 using namespace glm;
 
+mat4 rotateAbout(vec3 axis, float radians);
+
 class Camera{
 public:
 	vec3 dir;
 	vec3 up;
 	vec3 right;
-	vec3 pos;
+	dvec3 pos;			//Double precision so the camera can sit far from the world origin
 	vec3 sphereCoords;
-	vec3 atSphere;
+	dvec3 atSphere;
 	float sphereRadius;
 
+	//Basis and matrices are rebuilt lazily, only after something moved
+	bool dirty;
+	mat4 viewMatrix;
+	mat4 rotationMatrix;
+
+	//Eased hand-over when the focus body changes
+	bool transitioning;
+	bool captureStart;
+	double transitionTime;
+	double transitionDuration;
+	dvec3 startOffset;
+	float startDistance;
+	float goalDistance;
+	float startSphereRadius;
+
 	Camera();
-	Camera(vec3 _sphereCoords, vec3 _atSphere, float _sphereRadius);
+	Camera(vec3 _sphereCoords, dvec3 _atSphere, float _sphereRadius);
 
 	void updateThings();
 	mat4 getMatrix();
+	mat4 getRotationMatrix();
+	dvec3 getEye();
 
 	void moveCamera(float deltaPhi, float deltaTheta, float deltaRadius);
 
+	void setTarget(dvec3 _atSphere, float _sphereRadius);
+	void startTransition(float _goalDistance, double duration);
+	void update(double dt);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,88 @@
+#include "culling.h"
+#include <cfloat>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULL_SSE
+#endif
+
+void setPlane(Frustum& frustum, int i, vec4 plane)
+{
+	//An infinite far plane comes out with no normal; let everything pass it
+	float len = length(vec3(plane));
+	if(len < 1e-12f)
+		plane = vec4(0.f, 0.f, 0.f, FLT_MAX);
+	else
+		plane /= len;
+	frustum.nx[i] = plane.x;
+	frustum.ny[i] = plane.y;
+	frustum.nz[i] = plane.z;
+	frustum.d[i] = plane.w;
+}
+
+void extractFrustum(const mat4& clipMatrix, Frustum& frustum, bool zeroToOne)
+{
+	mat4 rows = transpose(clipMatrix);
+
+	setPlane(frustum, 0, rows[3] + rows[0]);		//Left
+	setPlane(frustum, 1, rows[3] - rows[0]);		//Right
+	setPlane(frustum, 2, rows[3] + rows[1]);		//Bottom
+	setPlane(frustum, 3, rows[3] - rows[1]);		//Top
+	if(zeroToOne){
+		setPlane(frustum, 4, rows[2]);				//0 <= z
+		setPlane(frustum, 5, rows[3] - rows[2]);	//z <= w
+	}
+	else{
+		setPlane(frustum, 4, rows[3] + rows[2]);	//Near
+		setPlane(frustum, 5, rows[3] - rows[2]);	//Far
+	}
+
+	//Padding planes that every sphere is in front of
+	for(int i = 6; i < FRUSTUM_PLANES; i++){
+		frustum.nx[i] = frustum.ny[i] = frustum.nz[i] = 0.f;
+		frustum.d[i] = FLT_MAX;
+	}
+}
+
+int cullSpheres(const Frustum& frustum, const vec4* spheres, int count, unsigned char* visible)
+{
+	int numVisible = 0;
+
+#ifdef CULL_SSE
+	__m128 nx0 = _mm_loadu_ps(&frustum.nx[0]), nx1 = _mm_loadu_ps(&frustum.nx[4]);
+	__m128 ny0 = _mm_loadu_ps(&frustum.ny[0]), ny1 = _mm_loadu_ps(&frustum.ny[4]);
+	__m128 nz0 = _mm_loadu_ps(&frustum.nz[0]), nz1 = _mm_loadu_ps(&frustum.nz[4]);
+	__m128 d0 = _mm_loadu_ps(&frustum.d[0]), d1 = _mm_loadu_ps(&frustum.d[4]);
+
+	for(int i = 0; i < count; i++){
+		__m128 cx = _mm_set1_ps(spheres[i].x);
+		__m128 cy = _mm_set1_ps(spheres[i].y);
+		__m128 cz = _mm_set1_ps(spheres[i].z);
+		__m128 negRadius = _mm_set1_ps(-spheres[i].w);
+
+		__m128 dist0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx0, cx), _mm_mul_ps(ny0, cy)),
+								_mm_add_ps(_mm_mul_ps(nz0, cz), d0));
+		__m128 dist1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx1, cx), _mm_mul_ps(ny1, cy)),
+								_mm_add_ps(_mm_mul_ps(nz1, cz), d1));
+
+		//Outside if entirely behind any plane
+		int outside = _mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(dist0, negRadius),
+												_mm_cmplt_ps(dist1, negRadius)));
+		visible[i] = (outside == 0);
+		numVisible += visible[i];
+	}
+#else
+	for(int i = 0; i < count; i++){
+		bool inside = true;
+		for(int p = 0; p < 6 && inside; p++){
+			float dist = frustum.nx[p]*spheres[i].x + frustum.ny[p]*spheres[i].y
+						+ frustum.nz[p]*spheres[i].z + frustum.d[p];
+			inside = (dist >= -spheres[i].w);
+		}
+		visible[i] = inside;
+		numVisible += visible[i];
+	}
+#endif
+
+	return numVisible;
+}
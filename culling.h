@@ -0,0 +1,36 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "glm/glm.hpp"
+
+using namespace glm;
+
+#define FRUSTUM_PLANES 8		//Six real planes, padded to two groups of four
+
+/*
+	Frustum planes stored SoA so one SIMD register holds the same component
+	of four planes; a sphere is tested against four planes per instruction.
+	Planes point inwards and are normalized, so dot(n, c) + d is a distance.
+*/
+struct Frustum{
+	float nx[FRUSTUM_PLANES];
+	float ny[FRUSTUM_PLANES];
+	float nz[FRUSTUM_PLANES];
+	float d[FRUSTUM_PLANES];
+};
+
+struct CullStats{
+	int visible;
+	int culled;		//Outside the frustum
+	int occluded;		//Inside the frustum but hidden behind other bodies
+	int dropped;		//Visible, but past what one frame's draw batches hold
+};
+
+//Planes of clip = perspective * camera (Gribb/Hartmann); zeroToOne selects
+//glClipControl's [0, w] depth range instead of [-w, w]
+void extractFrustum(const mat4& clipMatrix, Frustum& frustum, bool zeroToOne);
+
+//spheres are (center, radius); writes 1/0 per sphere and returns the number visible
+int cullSpheres(const Frustum& frustum, const vec4* spheres, int count, unsigned char* visible);
+
+#endif
@@ -0,0 +1,43 @@
+#include "depthprecision.h"
+#include <cmath>
+#include <cstdio>
+
+//Standard GL projection: window depth for a view distance, then back again
+double standardDistance(double windowDepth, double A, double B)
+{
+	double ndc = 2.0*windowDepth - 1.0;
+	return B/(ndc + A);
+}
+
+void reportDepthPrecision(float zNear, float zFar, float maxDistance)
+{
+	const double quanta = 16777215.0;		//2^24 - 1
+	double A = -(zFar + zNear)/(double)(zFar - zNear);
+	double B = -2.0*zFar*zNear/(double)(zFar - zNear);
+
+	printf("Depth precision (near %g, far %g):\n", zNear, zFar);
+	printf("%12s | %14s %14s | %14s %14s\n", "distance",
+			"24-bit error", "24-bit step", "rev-Z error", "rev-Z step");
+
+	for(double distance = zNear*5.0; ; distance *= 2.0){
+		if(distance > maxDistance)
+			distance = maxDistance;
+
+		//What the GPU stores, then what that value decodes to
+		float ndc = (float)(-A + B/distance);
+		double stored = floor((0.5*ndc + 0.5)*quanta + 0.5);
+		double standardBack = standardDistance(stored/quanta, A, B);
+		double standardStep = fabs(standardDistance((stored - 1.0)/quanta, A, B) - standardBack);
+
+		float reverse = (float)(zNear/distance);
+		double reverseBack = zNear/(double)reverse;
+		double reverseStep = zNear/(double)nextafterf(reverse, 0.f) - reverseBack;
+
+		printf("%12.3f | %14.6g %14.6g | %14.6g %14.6g\n", distance,
+				fabs(standardBack - distance), standardStep,
+				fabs(reverseBack - distance), reverseStep);
+
+		if(distance == maxDistance)
+			break;
+	}
+}
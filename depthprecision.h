@@ -0,0 +1,9 @@
+#ifndef DEPTHPRECISION_H
+#define DEPTHPRECISION_H
+
+//Prints, for distances out to the star shell, the smallest depth step each
+//convention can resolve: standard [-1,1] projection into a 24-bit fixed-point
+//buffer versus reverse-Z infinite projection into a 32-bit float buffer
+void reportDepthPrecision(float zNear, float zFar, float maxDistance);
+
+#endif
@@ -0,0 +1,104 @@
+#include "dynamicres.h"
+#include <cmath>
+
+DynamicResolution::DynamicResolution():	enabled(false),
+										scale(1.f),
+										minScale(1.f),
+										maxScale(1.f),
+										budget(0.0),
+										gpuTime(0.0),
+										current(0),
+										timing(false),
+										settle(0)
+{
+	for(int i=0; i<DYNRES_QUERIES; i++){
+		queries[i] = 0;
+		pending[i] = false;
+	}
+}
+
+void DynamicResolution::init(double budgetMs, float _minScale, float _maxScale)
+{
+	enabled = true;
+	budget = budgetMs/1000.0;
+	minScale = _minScale;
+	maxScale = _maxScale;
+	scale = maxScale;
+	gpuTime = 0.0;
+	settle = DYNRES_SETTLE;
+	glGenQueries(DYNRES_QUERIES, queries);
+}
+
+void DynamicResolution::destroy()
+{
+	if(enabled)
+		glDeleteQueries(DYNRES_QUERIES, queries);
+	enabled = false;
+}
+
+void DynamicResolution::begin()
+{
+	//Skip timing rather than stall if this query's result is still outstanding
+	timing = enabled && !pending[current];
+	if(timing)
+		glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+void DynamicResolution::end()
+{
+	if(!timing)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	current = (current + 1) % DYNRES_QUERIES;
+}
+
+//Folds in whatever timings have arrived and returns the scale for the next frame
+float DynamicResolution::update()
+{
+	if(!enabled)
+		return 1.f;
+
+	for(int i=1; i<=DYNRES_QUERIES; i++){
+		int q = (current + i) % DYNRES_QUERIES;		//Oldest first
+		if(!pending[q])
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+			break;
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[q], GL_QUERY_RESULT, &elapsed);
+		pending[q] = false;
+
+		double seconds = elapsed*1e-9;
+		gpuTime = (gpuTime == 0.0) ? seconds : gpuTime + (seconds - gpuTime)*0.1;
+	}
+
+	if(settle > 0){
+		settle--;
+		return scale;
+	}
+
+	//Drop as soon as we are over budget, climb back only with some headroom
+	if(gpuTime > budget || gpuTime < budget*0.8){
+		float next = scale*(float)sqrt(budget/gpuTime);
+		if(next < scale*0.85f)
+			next = scale*0.85f;
+		else if(next > scale*1.1f)
+			next = scale*1.1f;
+		if(next < minScale)
+			next = minScale;
+		else if(next > maxScale)
+			next = maxScale;
+
+		if(next != scale){
+			scale = next;
+			settle = DYNRES_SETTLE;
+		}
+	}
+
+	return scale;
+}
@@ -0,0 +1,43 @@
+#ifndef DYNAMICRES_H
+#define DYNAMICRES_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#define DYNRES_QUERIES 4		//Frames of GPU timing in flight
+#define DYNRES_SETTLE 12		//Frames to let a new scale show up in the timings
+
+/*
+	Picks the fraction of the window resolution the scene is rendered at so
+	its GPU time stays under a budget. Timing comes from GL_TIME_ELAPSED
+	queries read back a few frames late, so the CPU never waits on them.
+	Pixel cost goes with scale squared, so steps are sized by sqrt(budget/time).
+
+	begin() -> scene draws -> end() -> update()
+*/
+class DynamicResolution{
+public:
+	bool enabled;
+	float scale;
+	float minScale, maxScale;
+	double budget;			//Seconds
+	double gpuTime;			//Smoothed seconds per frame, 0 until the first result
+	GLuint queries[DYNRES_QUERIES];
+	bool pending[DYNRES_QUERIES];
+	int current;
+	bool timing;
+	int settle;
+
+	DynamicResolution();
+
+	void init(double budgetMs, float _minScale, float _maxScale);
+	void destroy();
+
+	void begin();
+	void end();
+	float update();
+};
+
+#endif
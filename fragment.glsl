@@ -14,16 +14,26 @@ out vec4 FragmentColour;
 in vec3 FragNormal;
 in vec2 FragUV;
 in vec4 worldPos;
+flat in int FragDiffuse;
 
 uniform sampler2D sphereTex;
-uniform bool isDiffuse;
+
+// positions are relative to the eye, so the sun is passed in rather than at 0
+layout(std140) uniform FrameBlock
+{
+	mat4 cameraMatrix;
+	mat4 perspectiveMatrix;
+	mat4 skyMatrix;
+	vec4 lightPosition;
+	float farDepth;
+};
 
 void main(void)
 {
 	vec4 planetCol = texture(sphereTex, FragUV);
-	if(isDiffuse){
+	if(FragDiffuse != 0){
 		vec4 sunCol = vec4(1);
-		vec3 lightRay = normalize(vec3(0) - worldPos.xyz);
+		vec3 lightRay = normalize(lightPosition.xyz - worldPos.xyz);
 		FragmentColour = planetCol * sunCol * max(0.1, dot(FragNormal, lightRay));
 	}
 	else
@@ -0,0 +1,138 @@
+#include "framepacing.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+using namespace std;
+
+double clockSeconds()
+{
+	static const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+FramePacer::FramePacer():	vsync(VSYNC::ON),
+							targetFPS(0.0),
+							period(0.0),
+							deadline(0.0),
+							lastFrame(0.0),
+							count(0)
+{}
+
+//Needs a current context; adaptive vsync falls back to plain vsync without
+//the swap_control_tear extension. Without swapControl (no window) only the
+//cap applies
+void FramePacer::init(int _vsync, double _targetFPS, bool swapControl)
+{
+	vsync = swapControl ? _vsync : VSYNC::OFF;
+	if(vsync == VSYNC::ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear")
+								&& !glfwExtensionSupported("GLX_EXT_swap_control_tear")){
+		printf("FramePacer: adaptive vsync unsupported, using vsync\n");
+		vsync = VSYNC::ON;
+	}
+	if(swapControl)
+		glfwSwapInterval(vsync == VSYNC::ADAPTIVE ? -1 : vsync);
+
+	targetFPS = _targetFPS;
+	period = (targetFPS > 0.0) ? 1.0/targetFPS : 0.0;
+	resync();
+}
+
+//Holds the frame back until its deadline when a cap is set
+void FramePacer::wait()
+{
+	if(period <= 0.0)
+		return;
+	PROFILE_ZONE("pacing");
+
+	double now = clockSeconds();
+	if(deadline == 0.0 || now - deadline > period){
+		//First frame, or we fell more than a frame behind: don't try to catch up
+		deadline = now + period;
+		return;
+	}
+
+	double remaining = deadline - now;
+	while(remaining > PACING_SPIN){
+		this_thread::sleep_for(chrono::microseconds((long long)((remaining - PACING_SPIN)*1e6)));
+		remaining = deadline - clockSeconds();
+	}
+	while(clockSeconds() < deadline);
+
+	deadline += period;
+}
+
+void FramePacer::frameDone()
+{
+	double now = clockSeconds();
+	if(lastFrame > 0.0){
+		intervals[count % PACING_HISTORY] = now - lastFrame;
+		count++;
+	}
+	lastFrame = now;
+}
+
+//Forget the cadence after the loop slept on purpose, so the gap is not
+//counted as a frame
+void FramePacer::resync()
+{
+	deadline = 0.0;
+	lastFrame = 0.0;
+}
+
+static double percentile(const double* sorted, int n, double p)
+{
+	int i = (int)(p*(n - 1) + 0.5);
+	return sorted[i];
+}
+
+//Over the most recent window intervals; sorting costs grow with the window,
+//so callers inside the frame should keep it short
+PacingStats FramePacer::stats(int window)
+{
+	PacingStats s = {};
+	int n = (count < PACING_HISTORY) ? count : PACING_HISTORY;
+	if(n > window)
+		n = window;
+	s.frames = n;
+	if(n == 0)
+		return s;
+
+	for(int i=0; i<n; i++)
+		sorted[i] = intervals[(count - n + i) % PACING_HISTORY];
+	double sum = 0.0;
+	for(int i=0; i<n; i++)
+		sum += sorted[i];
+	s.mean = sum/n;
+
+	for(int i=0; i<n; i++)
+		jitter[i] = fabs(sorted[i] - s.mean);
+
+	sort(sorted, sorted + n);
+	sort(jitter, jitter + n);
+	s.p50 = percentile(sorted, n, 0.50);
+	s.p95 = percentile(sorted, n, 0.95);
+	s.p99 = percentile(sorted, n, 0.99);
+	s.worst = sorted[n - 1];
+	s.jitter50 = percentile(jitter, n, 0.50);
+	s.jitter95 = percentile(jitter, n, 0.95);
+	s.jitter99 = percentile(jitter, n, 0.99);
+	return s;
+}
+
+void FramePacer::report()
+{
+	PacingStats s = stats();
+	if(s.frames == 0)
+		return;
+
+	const char* modes[] = {"off", "on", "adaptive"};
+	printf("Frame pacing (vsync %s, cap %g fps) over %d frames:\n", modes[vsync], targetFPS, s.frames);
+	printf("  interval ms: mean %.3f  p50 %.3f  p95 %.3f  p99 %.3f  worst %.3f\n",
+			s.mean*1e3, s.p50*1e3, s.p95*1e3, s.p99*1e3, s.worst*1e3);
+	printf("  jitter ms:   p50 %.3f  p95 %.3f  p99 %.3f\n",
+			s.jitter50*1e3, s.jitter95*1e3, s.jitter99*1e3);
+}
@@ -0,0 +1,59 @@
+#ifndef FRAMEPACING_H
+#define FRAMEPACING_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#define PACING_HISTORY 4096			//Frame intervals kept for the statistics
+#define PACING_SPIN 0.002			//Seconds before a deadline we stop sleeping and spin
+
+//Monotonic seconds; works without a window or glfwInit()
+double clockSeconds();
+
+struct VSYNC{
+	enum{OFF=0, ON, ADAPTIVE};
+};
+
+//Frame-to-frame intervals in seconds; jitter is |interval - mean interval|
+struct PacingStats{
+	int frames;
+	double mean, p50, p95, p99, worst;
+	double jitter50, jitter95, jitter99;
+};
+
+/*
+	Owns the swap interval and an optional frame rate cap. The cap sleeps
+	until just before each deadline, then spins the rest of the way, because
+	OS sleeps routinely overshoot by a millisecond or more. Deadlines advance
+	by a fixed period so the cadence stays even instead of drifting.
+
+	wait() -> glfwSwapBuffers() -> frameDone()
+*/
+class FramePacer{
+public:
+	int vsync;
+	double targetFPS;			//0 is uncapped
+	double period;
+	double deadline;
+	double lastFrame;			//Time of the previous frameDone(), 0 before the first
+	double intervals[PACING_HISTORY];
+	int count;
+
+	//Scratch for stats(), which the HUD calls while the loop runs
+	double sorted[PACING_HISTORY];
+	double jitter[PACING_HISTORY];
+
+	FramePacer();
+
+	void init(int _vsync, double _targetFPS, bool swapControl);
+	void wait();
+	void frameDone();
+	void resync();
+
+	PacingStats stats(int window = PACING_HISTORY);
+	void report();
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "geometry.h"
+
+#define PI 3.14159265359
+
+using namespace std;
+
+void generateSphere(vector<vec3>& positions, vector<vec3>& normals, 
+					vector<vec2>& uvs, vector<unsigned int>& indices,
+					float radius, vec3 center, int divisions)
+{
+	float step = 1.f/(float)(divisions-1);
+
+	float phi = 0.f;
+	vec3 pos;
+
+	//Traversing phi
+	for(int i=0; i<divisions; i++) {
+		float theta = 0.f;
+
+		//Traversing v
+		for(int j=0; j<divisions; j++) {
+			pos = radius * vec3(cos(2.f * PI * theta) * sin(PI * phi),
+								sin(2.f * PI * theta) * sin(PI * phi),
+								cos(PI * phi)) + center;
+
+			vec3 normal = normalize(pos - center);
+			
+			positions.push_back(pos);
+			normals.push_back(normal);
+			uvs.push_back(vec2(theta, phi));
+
+			theta += step;
+		}
+		phi += step;
+	}
+
+	for(int i=0; i<divisions-1; i++)
+	{
+		for(int j=0; j<divisions-1; j++)
+		{
+			unsigned int p00 = i*divisions+j;
+			unsigned int p01 = i*divisions+j+1;
+			unsigned int p10 = (i+1)*divisions + j;
+			unsigned int p11 = (i+1)*divisions + j + 1;
+
+			indices.push_back(p00);
+			indices.push_back(p10);
+			indices.push_back(p01);
+
+			indices.push_back(p01);
+			indices.push_back(p10);
+			indices.push_back(p11);
+		}
+	}
+}
+
+//Builds a body's modelview matrix from its center and accumulated spin
+//	The translation is taken relative to origin in double precision first, so
+//	only a small camera-relative offset is ever rounded to float
+mat4 bodyMatrix(dvec3 spherePos, dmat3 orientation, dvec3 origin)
+{
+	mat4 matrix = mat4(mat3(orientation));
+	matrix[3] = vec4(vec3(spherePos - origin), 1.f);
+	return matrix;
+}
+
+//Rotation by angle about axis, in the row-vector form rotate() and orbit() apply
+dmat3 rotationAbout(dvec3 axis, double angle)
+{
+    axis = normalize(axis);
+    double x = axis.x;
+    double y = axis.y;
+    double z = axis.z;
+    double x2 = x * x;
+    double y2 = y * y;
+    double z2 = z * z;
+    double s = sin(angle);
+    double c = cos(angle);
+    double oc = 1.0 - c;
+    
+    return dmat3(	c + x2*oc,	x*y*oc - z*s,	x*z*oc + y*s,
+    				y*x*oc + z*s,	c + y2*oc,	y*z*oc - x*s,
+    				z*x*oc - y*s,	z*y*oc + x*s,	c + z2*oc);
+}
+
+//Spins a body about its own center
+void rotate(dmat3& orientation, dvec3 axis, double angle)
+{
+	//p' = (p - center) * R + center, applied once to the basis instead of every vertex
+	orientation = transpose(rotationAbout(axis, angle)) * orientation;
+}
+
+//Carries a body around its parent without changing which way it faces
+void orbit(dvec3 parentSphere, dvec3 &spherePos, dvec3 axis, double angle)
+{
+   	spherePos = ((spherePos - parentSphere) * rotationAbout(axis, angle)) + parentSphere;
+}
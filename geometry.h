@@ -0,0 +1,21 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <vector>
+#include "glm/glm.hpp"
+
+using namespace glm;
+
+//UV sphere of divisions x divisions vertices, appended to the arrays
+void generateSphere(std::vector<vec3>& positions, std::vector<vec3>& normals,
+					std::vector<vec2>& uvs, std::vector<unsigned int>& indices,
+					float radius, vec3 center, int divisions);
+
+//Model matrix of a body relative to a floating origin
+mat4 bodyMatrix(dvec3 spherePos, dmat3 orientation, dvec3 origin);
+
+dmat3 rotationAbout(dvec3 axis, double angle);
+void rotate(dmat3& orientation, dvec3 axis, double angle);
+void orbit(dvec3 parentSphere, dvec3 &spherePos, dvec3 axis, double angle);
+
+#endif
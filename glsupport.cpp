@@ -0,0 +1,21 @@
+#include "glsupport.h"
+#include <cstring>
+
+bool hasGLVersion(int major, int minor)
+{
+	GLint contextMajor, contextMinor;
+	glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+bool hasGLExtension(const char* name)
+{
+	GLint numExtensions;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for(int i=0; i<numExtensions; i++){
+		if(strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+			return true;
+	}
+	return false;
+}
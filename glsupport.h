@@ -0,0 +1,13 @@
+#ifndef GLSUPPORT_H
+#define GLSUPPORT_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+//Queries against the current context, for picking newer paths at runtime
+bool hasGLVersion(int major, int minor);
+bool hasGLExtension(const char* name);
+
+#endif
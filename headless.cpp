@@ -0,0 +1,116 @@
+#include "headless.h"
+#include <iostream>
+
+using namespace std;
+
+HeadlessContext::HeadlessContext():	display(0),
+									context(0)
+{}
+
+#ifdef __linux__
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+
+static bool hasEGLExtension(EGLDisplay display, const char* name)
+{
+	const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if(extensions == 0)
+		return false;
+
+	size_t length = strlen(name);
+	for(const char* found = strstr(extensions, name); found; found = strstr(found + length, name)){
+		if((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == 0))
+			return true;
+	}
+	return false;
+}
+
+bool HeadlessContext::init(int width, int height)
+{
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+
+	//Client extensions are queried without a display
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(getPlatformDisplay && hasEGLExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless"))
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+	if(eglDisplay == EGL_NO_DISPLAY)
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if(eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)){
+		cout << "Headless: no EGL display" << endl;
+		return false;
+	}
+	display = eglDisplay;
+
+	if(!hasEGLExtension(eglDisplay, "EGL_KHR_surfaceless_context")){
+		cout << "Headless: EGL_KHR_surfaceless_context is not supported" << endl;
+		destroy();
+		return false;
+	}
+
+	EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE};
+	EGLConfig config;
+	EGLint configs = 0;
+	if(!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configs) || configs == 0){
+		cout << "Headless: no desktop OpenGL config" << endl;
+		destroy();
+		return false;
+	}
+
+	//Newest core profile first, down to the 4.1 the renderer needs
+	for(int version = 6; version >= 1 && context == 0; version--){
+		EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 4,
+			EGL_CONTEXT_MINOR_VERSION, version,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE};
+		EGLContext created = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+		if(created != EGL_NO_CONTEXT)
+			context = created;
+	}
+
+	if(context == 0 || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)context)){
+		cout << "Headless: could not create a GL 4.1+ core context" << endl;
+		destroy();
+		return false;
+	}
+
+	if(!target.init(width, height, GL_DEPTH_COMPONENT24)){
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+void HeadlessContext::destroy()
+{
+	if(context)
+		target.destroy();
+	if(display){
+		eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if(context)
+			eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+		eglTerminate((EGLDisplay)display);
+	}
+	display = context = 0;
+}
+
+#else
+
+bool HeadlessContext::init(int width, int height)
+{
+	cout << "Headless: EGL rendering is only available on Linux" << endl;
+	return false;
+}
+
+void HeadlessContext::destroy()
+{}
+
+#endif
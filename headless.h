@@ -0,0 +1,29 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#include "rendertarget.h"
+
+/*
+	GL 4.1+ core context with no window or display server, for render nodes
+	and automated runs. Uses EGL on Mesa's surfaceless platform (works on
+	llvmpipe), falling back to the default EGL display. There is no default
+	framebuffer, so frames are "presented" into target instead of a window.
+*/
+class HeadlessContext{
+public:
+	void* display;			//EGLDisplay / EGLContext, kept opaque so EGL stays out of the header
+	void* context;
+	RenderTarget target;
+
+	HeadlessContext();
+
+	bool init(int width, int height);
+	void destroy();
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "input.h"
+
+InputQueue::InputQueue():	head(0),
+							tail(0),
+							dropped(0)
+{}
+
+bool InputQueue::push(const InputEvent& event)
+{
+	unsigned int limit = INPUT_QUEUE_SIZE;
+	if(event.type == InputEvent::MOTION)
+		limit -= INPUT_QUEUE_RESERVE;
+
+	unsigned int h = head.load(std::memory_order_relaxed);
+	if(h - tail.load(std::memory_order_acquire) >= limit){
+		dropped++;
+		return false;
+	}
+
+	events[h & (INPUT_QUEUE_SIZE - 1)] = event;
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
+
+bool InputQueue::pop(InputEvent* event)
+{
+	unsigned int t = tail.load(std::memory_order_relaxed);
+	if(t == head.load(std::memory_order_acquire))
+		return false;
+
+	*event = events[t & (INPUT_QUEUE_SIZE - 1)];
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+static void pushEvent(InputQueue& queue, int type, int a, int b, double x, double y)
+{
+	InputEvent event;
+	event.type = type;
+	event.a = a;
+	event.b = b;
+	event.x = x;
+	event.y = y;
+	queue.push(event);
+}
+
+void inputKey(InputQueue& queue, int key, int action)
+{
+	pushEvent(queue, InputEvent::KEY, key, action, 0.0, 0.0);
+}
+
+void inputButton(InputQueue& queue, int button, int action)
+{
+	pushEvent(queue, InputEvent::BUTTON, button, action, 0.0, 0.0);
+}
+
+void inputMotion(InputQueue& queue, double x, double y)
+{
+	pushEvent(queue, InputEvent::MOTION, 0, 0, x, y);
+}
+
+void inputScroll(InputQueue& queue, double xoffset, double yoffset)
+{
+	pushEvent(queue, InputEvent::SCROLL, 0, 0, xoffset, yoffset);
+}
+
+void inputResize(InputQueue& queue, int width, int height)
+{
+	pushEvent(queue, InputEvent::RESIZE, width, height, 0.0, 0.0);
+}
+
+void inputRefresh(InputQueue& queue)
+{
+	pushEvent(queue, InputEvent::REFRESH, 0, 0, 0.0, 0.0);
+}
@@ -0,0 +1,42 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <atomic>
+
+#define INPUT_QUEUE_SIZE 256		//Power of two
+#define INPUT_QUEUE_RESERVE 32		//Slots only non-motion events may use
+
+struct InputEvent{
+	enum{KEY=0, BUTTON, MOTION, SCROLL, RESIZE, REFRESH};
+	int type;
+	int a, b;			//KEY: key, action  BUTTON: button, action  RESIZE: width, height
+	double x, y;		//MOTION: cursor position  SCROLL: offsets
+};
+
+/*
+	Lock-free single-producer/single-consumer ring. The GLFW callbacks push,
+	the frame's input stage pops; neither side ever blocks or touches GL.
+	When the ring fills up new events are dropped, cursor motion first: it
+	carries absolute positions, so losing some only coarsens the path.
+*/
+class InputQueue{
+public:
+	InputEvent events[INPUT_QUEUE_SIZE];
+	std::atomic<unsigned int> head;		//Next slot to write, owned by the producer
+	std::atomic<unsigned int> tail;		//Next slot to read, owned by the consumer
+	unsigned int dropped;
+
+	InputQueue();
+
+	bool push(const InputEvent& event);
+	bool pop(InputEvent* event);
+};
+
+void inputKey(InputQueue& queue, int key, int action);
+void inputButton(InputQueue& queue, int button, int action);
+void inputMotion(InputQueue& queue, double x, double y);
+void inputScroll(InputQueue& queue, double xoffset, double yoffset);
+void inputResize(InputQueue& queue, int width, int height);
+void inputRefresh(InputQueue& queue);
+
+#endif
@@ -0,0 +1,472 @@
+// ==========================================================================
+// CPU micro-benchmarks for the math and geometry kernels
+//
+// A separate program from the renderer; no window or GL context needed.
+//    kernelbench [filter] [--reps N]
+// runs every kernel whose name contains filter over a range of sizes and
+// prints ns/element, plus hardware counters where perf_event_open allows.
+// The SIMD batch kernels are checked against glm before anything is timed.
+// ==========================================================================
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "geometry.h"
+#include "camera.h"
+#include "transform.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+#define KB_WARMUP 3				//Untimed runs before measuring
+#define KB_REPS 31				//Timed repetitions, --reps
+#define KB_MIN_SECONDS 0.002	//A repetition loops the kernel for at least this long
+#define KB_OUTLIER_MADS 3.0		//Repetitions further than this from the median are dropped
+#define KB_MAX_SIZES 4
+
+struct COUNTER{
+	enum {CYCLES=0, INSTRUCTIONS, CACHE_MISSES, COUNT};
+};
+
+/*
+	Cycles, instructions and last-level cache misses for this thread, read
+	around each repetition. Commonly unavailable in containers and VMs or
+	with a strict perf_event_paranoid; the timings are reported either way.
+*/
+class PerfCounters{
+public:
+	int fds[COUNTER::COUNT];
+	bool available;
+
+	PerfCounters(): available(false)
+	{
+		for(int i=0; i<COUNTER::COUNT; i++)
+			fds[i] = -1;
+	}
+
+	bool open()
+	{
+#ifdef __linux__
+		const unsigned long long configs[COUNTER::COUNT] = {PERF_COUNT_HW_CPU_CYCLES,
+															 PERF_COUNT_HW_INSTRUCTIONS,
+															 PERF_COUNT_HW_CACHE_MISSES};
+		for(int i=0; i<COUNTER::COUNT; i++){
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = configs[i];
+			attr.disabled = (i == 0);		//The group leader starts them all
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, (i == 0) ? -1 : fds[0], 0);
+			if(fds[i] < 0){
+				close();
+				return false;
+			}
+		}
+		available = true;
+#endif
+		return available;
+	}
+
+	void close()
+	{
+#ifdef __linux__
+		for(int i=0; i<COUNTER::COUNT; i++){
+			if(fds[i] >= 0)
+				::close(fds[i]);
+			fds[i] = -1;
+		}
+#endif
+		available = false;
+	}
+
+	void start()
+	{
+#ifdef __linux__
+		if(!available)
+			return;
+		ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	void stop(double values[COUNTER::COUNT])
+	{
+		for(int i=0; i<COUNTER::COUNT; i++)
+			values[i] = 0.0;
+#ifdef __linux__
+		if(!available)
+			return;
+		ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		for(int i=0; i<COUNTER::COUNT; i++){
+			long long count = 0;
+			if(read(fds[i], &count, sizeof(count)) == sizeof(count))
+				values[i] = (double)count;
+		}
+#endif
+	}
+};
+
+//One kernel in one implementation; scalar, SIMD and threaded variants of
+//the same routine share a name so they print next to each other
+struct Kernel{
+	const char* name;
+	const char* variant;
+	void (*setup)(int size);
+	void (*run)(int size);
+	bool squared;		//size is a grid edge, size*size elements
+	int simd;			//Instruction set the variant needs, skipped if the CPU lacks it
+	int sizes[KB_MAX_SIZES];
+};
+
+struct KernelResult{
+	double nsPerElement;		//Mean of the repetitions that were kept
+	double minPerElement;
+	int kept;
+	double counters[COUNTER::COUNT];		//Per element, over the kept repetitions
+};
+
+// --------------------------------------------------------------------------
+// Inputs, rebuilt by each kernel's setup for the size under test
+
+vector<vec3> spherePositions, sphereNormals;
+vector<vec2> sphereUvs;
+vector<unsigned int> sphereIndices;
+
+vector<dvec3> axes;
+vector<double> angles;
+vector<dmat3> orientations;
+vector<dvec3> positions;
+vector<Camera> cameras;
+PointsSoA points;
+mat3 pointRotation;
+
+volatile double sink;		//Keeps results observable so nothing is optimized away
+
+double random01()
+{
+	return rand()/(double)RAND_MAX;
+}
+
+void setupSphere(int divisions)
+{
+	spherePositions.reserve(divisions*divisions);
+	sphereNormals.reserve(divisions*divisions);
+	sphereUvs.reserve(divisions*divisions);
+	sphereIndices.reserve((divisions - 1)*(divisions - 1)*6);
+}
+
+void setupBodies(int count)
+{
+	srand(1);
+	axes.resize(count);
+	angles.resize(count);
+	orientations.assign(count, dmat3(1.0));
+	positions.resize(count);
+	for(int i=0; i<count; i++){
+		axes[i] = dvec3(random01() - 0.5, random01() - 0.5, random01() + 0.1);
+		angles[i] = random01()*0.01;
+		positions[i] = dvec3(random01(), random01(), random01())*100.0;
+	}
+}
+
+void setupPoints(int count)
+{
+	srand(1);
+	points.resize(count);
+	for(int i=0; i<count; i++)
+		points.set(i, vec3(random01() - 0.5, random01() - 0.5, random01() - 0.5)*10.f);
+	pointRotation = mat3(rotationAbout(dvec3(0.3, -0.2, 1.0), 0.01));
+}
+
+void setupCameras(int count)
+{
+	srand(1);
+	cameras.resize(count);
+	for(int i=0; i<count; i++){
+		vec3 coords = vec3(random01()*3.0, random01()*6.0, 10.0 + random01()*40.0);
+		cameras[i] = Camera(coords, dvec3(random01(), random01(), random01())*100.0, 5.f);
+	}
+}
+
+// --------------------------------------------------------------------------
+// Kernels
+
+void runGenerateSphere(int divisions)
+{
+	spherePositions.clear();
+	sphereNormals.clear();
+	sphereUvs.clear();
+	sphereIndices.clear();
+	generateSphere(spherePositions, sphereNormals, sphereUvs, sphereIndices, 1.f, vec3(0.f), divisions);
+	sink = spherePositions.back().x;
+}
+
+void runRotationAbout(int count)
+{
+	double sum = 0.0;
+	for(int i=0; i<count; i++){
+		dmat3 rotation = rotationAbout(axes[i], angles[i]);
+		sum += rotation[0][0] + rotation[1][1] + rotation[2][2];
+	}
+	sink = sum;
+}
+
+//The single-precision mat4 form in camera.cpp
+void runRotateAbout(int count)
+{
+	float sum = 0.f;
+	for(int i=0; i<count; i++){
+		mat4 rotation = rotateAbout(vec3(axes[i]), (float)angles[i]);
+		sum += rotation[0][0] + rotation[1][1] + rotation[2][2];
+	}
+	sink = sum;
+}
+
+void runRotate(int count)
+{
+	for(int i=0; i<count; i++)
+		rotate(orientations[i], axes[i], angles[i]);
+	sink = orientations[count - 1][0][0];
+}
+
+void runOrbit(int count)
+{
+	for(int i=0; i<count; i++)
+		orbit(dvec3(0.0), positions[i], axes[i], angles[i]);
+	sink = positions[count - 1].x;
+}
+
+//Batch rotate-about-point over SoA vertex arrays, one run per instruction set
+void runRotatePoints(int count, int level)
+{
+	rotatePoints(points, vec3(1.f, 2.f, 3.f), pointRotation, level);
+	sink = points.x[count - 1];
+}
+
+void runRotatePointsScalar(int count) { runRotatePoints(count, SIMD::SCALAR); }
+void runRotatePointsSSE(int count) { runRotatePoints(count, SIMD::SSE); }
+void runRotatePointsAVX2(int count) { runRotatePoints(count, SIMD::AVX2); }
+
+//Unit vectors stay unit vectors, so repeated runs see the same data
+void runRenormalize(int count, int level)
+{
+	renormalize(points, level);
+	sink = points.x[count - 1];
+}
+
+void runRenormalizeScalar(int count) { runRenormalize(count, SIMD::SCALAR); }
+void runRenormalizeSSE(int count) { runRenormalize(count, SIMD::SSE); }
+void runRenormalizeAVX2(int count) { runRenormalize(count, SIMD::AVX2); }
+
+void runUpdateThings(int count)
+{
+	for(int i=0; i<count; i++)
+		cameras[i].updateThings();
+	sink = cameras[count - 1].viewMatrix[3][0];
+}
+
+//Clean cameras: the cached path every frame takes when nothing moved
+void runGetMatrix(int count)
+{
+	float sum = 0.f;
+	for(int i=0; i<count; i++)
+		sum += cameras[i].getMatrix()[3][0];
+	sink = sum;
+}
+
+Kernel kernels[] = {
+	{"generateSphere", "scalar", setupSphere, runGenerateSphere, true, SIMD::SCALAR, {16, 64, 100, 256}},
+	{"rotationAbout", "scalar", setupBodies, runRotationAbout, false, SIMD::SCALAR, {16, 256, 4096, 65536}},
+	{"rotateAbout", "scalar", setupBodies, runRotateAbout, false, SIMD::SCALAR, {16, 256, 4096, 65536}},
+	{"rotate", "scalar", setupBodies, runRotate, false, SIMD::SCALAR, {16, 256, 4096, 65536}},
+	{"orbit", "scalar", setupBodies, runOrbit, false, SIMD::SCALAR, {16, 256, 4096, 65536}},
+	{"rotatePoints", "scalar", setupPoints, runRotatePointsScalar, false, SIMD::SCALAR, {16, 1024, 65536, 1048576}},
+	{"rotatePoints", "sse", setupPoints, runRotatePointsSSE, false, SIMD::SSE, {16, 1024, 65536, 1048576}},
+	{"rotatePoints", "avx2", setupPoints, runRotatePointsAVX2, false, SIMD::AVX2, {16, 1024, 65536, 1048576}},
+	{"renormalize", "scalar", setupPoints, runRenormalizeScalar, false, SIMD::SCALAR, {16, 1024, 65536, 1048576}},
+	{"renormalize", "sse", setupPoints, runRenormalizeSSE, false, SIMD::SSE, {16, 1024, 65536, 1048576}},
+	{"renormalize", "avx2", setupPoints, runRenormalizeAVX2, false, SIMD::AVX2, {16, 1024, 65536, 1048576}},
+	{"Camera::updateThings", "scalar", setupCameras, runUpdateThings, false, SIMD::SCALAR, {1, 16, 256, 4096}},
+	{"Camera::getMatrix", "scalar", setupCameras, runGetMatrix, false, SIMD::SCALAR, {1, 16, 256, 4096}},
+};
+const int kernelCount = sizeof(kernels)/sizeof(kernels[0]);
+
+// --------------------------------------------------------------------------
+// Correctness of the batch kernels against plain glm
+
+//Odd count so every SIMD path also runs its scalar tail
+#define CHECK_POINTS 1003
+#define CHECK_TOLERANCE 1e-5f		//Relative to the vector's length
+
+bool checkTransforms()
+{
+	bool passed = true;
+	vec3 center = vec3(1.f, 2.f, 3.f);
+	mat3 rotation = mat3(rotationAbout(dvec3(0.3, -0.2, 1.0), 0.7));
+
+	for(int level=0; level<=simdLevel(); level++){
+		float rotateError = 0.f, normalizeError = 0.f;
+		srand(7);
+		PointsSoA batch;
+		batch.resize(CHECK_POINTS);
+		vector<vec3> reference(CHECK_POINTS);
+		for(int i=0; i<CHECK_POINTS; i++){
+			reference[i] = vec3(random01() - 0.5, random01() - 0.5, random01() - 0.5)*(float)(1.0 + 100.0*random01());
+			batch.set(i, reference[i]);
+		}
+
+		rotatePoints(batch, center, rotation, level);
+		for(int i=0; i<CHECK_POINTS; i++){
+			vec3 expected = (reference[i] - center) * rotation + center;
+			rotateError = std::max(rotateError, length(batch.get(i) - expected)/std::max(1.f, length(expected)));
+			reference[i] = expected;
+		}
+
+		renormalize(batch, level);
+		for(int i=0; i<CHECK_POINTS; i++)
+			normalizeError = std::max(normalizeError, length(batch.get(i) - normalize(reference[i])));
+
+		bool ok = rotateError < CHECK_TOLERANCE && normalizeError < CHECK_TOLERANCE;
+		printf("Check %-6s rotatePoints %.2e  renormalize %.2e  %s\n", simdName(level), rotateError, normalizeError, ok ? "ok" : "FAILED");
+		passed = passed && ok;
+	}
+	return passed;
+}
+
+// --------------------------------------------------------------------------
+// Harness
+
+double seconds()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double median(vector<double> values)
+{
+	sort(values.begin(), values.end());
+	size_t middle = values.size()/2;
+	if(values.size() % 2)
+		return values[middle];
+	return 0.5*(values[middle - 1] + values[middle]);
+}
+
+KernelResult measure(const Kernel& kernel, int size, int reps, PerfCounters& counters)
+{
+	double elements = kernel.squared ? (double)size*size : (double)size;
+
+	kernel.setup(size);
+	for(int i=0; i<KB_WARMUP; i++)
+		kernel.run(size);
+
+	//Small sizes loop inside a repetition so the clock resolution doesn't dominate
+	double start = seconds();
+	kernel.run(size);
+	double once = seconds() - start;
+	int batch = (once > 0.0) ? (int)ceil(KB_MIN_SECONDS/once) : 1000;
+	batch = std::max(1, std::min(batch, 1000000));
+
+	vector<double> samples(reps);
+	vector<double> counts(reps*COUNTER::COUNT);
+	for(int r=0; r<reps; r++){
+		counters.start();
+		start = seconds();
+		for(int b=0; b<batch; b++)
+			kernel.run(size);
+		double elapsed = seconds() - start;
+		counters.stop(&counts[r*COUNTER::COUNT]);
+		samples[r] = elapsed*1e9/(batch*elements);
+	}
+
+	//Median absolute deviation rejects preemptions and frequency changes
+	//without letting them drag the mean around
+	double centre = median(samples);
+	vector<double> deviations(reps);
+	for(int r=0; r<reps; r++)
+		deviations[r] = fabs(samples[r] - centre);
+	double limit = KB_OUTLIER_MADS*1.4826*median(deviations);
+
+	KernelResult result;
+	memset(&result, 0, sizeof(result));
+	result.minPerElement = samples[0];
+	for(int r=0; r<reps; r++){
+		result.minPerElement = std::min(result.minPerElement, samples[r]);
+		if(fabs(samples[r] - centre) > limit && limit > 0.0)
+			continue;
+		result.nsPerElement += samples[r];
+		for(int c=0; c<COUNTER::COUNT; c++)
+			result.counters[c] += counts[r*COUNTER::COUNT + c];
+		result.kept++;
+	}
+	result.nsPerElement /= result.kept;
+	for(int c=0; c<COUNTER::COUNT; c++)
+		result.counters[c] /= result.kept*batch*elements;
+
+	return result;
+}
+
+int main(int argc, char *argv[])
+{
+	const char* filter = 0;
+	int reps = KB_REPS;
+	for(int i=1; i<argc; i++){
+		if(strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+			reps = std::max(3, atoi(argv[++i]));
+		else
+			filter = argv[i];
+	}
+
+	printf("SIMD level: %s\n", simdName(simdLevel()));
+	if(!checkTransforms())
+		return 1;
+
+	PerfCounters counters;
+	if(!counters.open())
+		cout << "Hardware counters unavailable (perf_event_open), reporting time only" << endl;
+
+	printf("%-22s %-8s %7s %10s %10s %10s %7s", "kernel", "variant", "size", "elements", "ns/elem", "min", "kept");
+	if(counters.available)
+		printf(" %10s %10s %6s %10s", "cycles/el", "instr/el", "IPC", "misses/el");
+	printf("\n");
+
+	for(int k=0; k<kernelCount; k++){
+		const Kernel& kernel = kernels[k];
+		if(filter && strstr(kernel.name, filter) == 0)
+			continue;
+		if(kernel.simd > simdLevel())
+			continue;
+
+		for(int s=0; s<KB_MAX_SIZES && kernel.sizes[s] > 0; s++){
+			int size = kernel.sizes[s];
+			KernelResult result = measure(kernel, size, reps, counters);
+
+			printf("%-22s %-8s %7d %10d %10.3f %10.3f %4d/%-2d", kernel.name, kernel.variant, size,
+					kernel.squared ? size*size : size, result.nsPerElement, result.minPerElement, result.kept, reps);
+			if(counters.available){
+				double cycles = result.counters[COUNTER::CYCLES];
+				double instructions = result.counters[COUNTER::INSTRUCTIONS];
+				printf(" %10.2f %10.2f %6.2f %10.4f", cycles, instructions,
+						(cycles > 0.0) ? instructions/cycles : 0.0, result.counters[COUNTER::CACHE_MISSES]);
+			}
+			printf("\n");
+		}
+	}
+
+	counters.close();
+	return 0;
+}
@@ -0,0 +1,205 @@
+#include "ktx.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+//KTX2 as written by texcook: one 2D image, one face, no supercompression,
+//	a basic data format descriptor and one key/value pair naming the source
+static const unsigned char identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+#define KTX_HEADER_SIZE 80				//Identifier, header and index up to the level index
+#define KTX_LEVEL_ENTRY 24
+#define KTX_SOURCE_KEY "texcook.source"	//Value is the source's key as 16 hex digits
+
+//Data format descriptor values (Khronos Data Format Specification 1.3)
+#define DFD_MODEL_BC1A 128
+#define DFD_MODEL_BC3 130
+#define DFD_PRIMARIES_BT709 1
+#define DFD_TRANSFER_LINEAR 1
+#define DFD_CHANNEL_COLOR 0
+#define DFD_CHANNEL_ALPHA 15
+
+static unsigned int get32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long get64(const unsigned char* p)
+{
+	return get32(p) | ((unsigned long long)get32(p + 4) << 32);
+}
+
+static void put32(vector<unsigned char>& out, unsigned int v)
+{
+	for(int i = 0; i < 4; i++)
+		out.push_back((v >> (8*i)) & 0xFF);
+}
+
+static void put64(vector<unsigned char>& out, unsigned long long v)
+{
+	put32(out, (unsigned int)v);
+	put32(out, (unsigned int)(v >> 32));
+}
+
+int ktxBlockBytes(unsigned int vkFormat)
+{
+	switch(vkFormat){
+		case KTX_FORMAT::BC1_RGB_UNORM:
+			return 8;
+		case KTX_FORMAT::BC3_UNORM:
+			return 16;
+	}
+	return 0;
+}
+
+size_t ktxLevelSize(int width, int height, int blockBytes)
+{
+	return (size_t)((width + 3)/4)*((height + 3)/4)*blockBytes;
+}
+
+static int levelDimension(int size, int level)
+{
+	return (size >> level) > 0 ? (size >> level) : 1;
+}
+
+//0 when the key/value data is missing, malformed or doesn't name the source
+static unsigned long long readSourceKey(const unsigned char* data, size_t size)
+{
+	const unsigned char* header = data + sizeof(identifier);
+	size_t offset = get32(header + 44), length = get32(header + 48);
+	if(offset > size || length > size - offset)
+		return 0;
+
+	const unsigned char* entry = data + offset;
+	const unsigned char* end = entry + length;
+	while(end - entry >= 4){
+		size_t entryLength = get32(entry);
+		if(entryLength > (size_t)(end - entry) - 4)
+			return 0;
+		const char* key = (const char*)entry + 4;
+		size_t keyLength = strlen(KTX_SOURCE_KEY) + 1;
+		if(entryLength == keyLength + 17 && memcmp(key, KTX_SOURCE_KEY, keyLength) == 0 && key[entryLength - 1] == 0)
+			return strtoull(key + keyLength, 0, 16);
+		entry += 4 + (entryLength + 3)/4*4;
+	}
+	return 0;
+}
+
+bool parseKTX2(const unsigned char* data, size_t size, KTXImage* image)
+{
+	if(size < KTX_HEADER_SIZE || memcmp(data, identifier, sizeof(identifier)) != 0)
+		return false;
+
+	const unsigned char* header = data + sizeof(identifier);
+	image->vkFormat = get32(header);
+	image->width = get32(header + 8);
+	image->height = get32(header + 12);
+	unsigned int depth = get32(header + 16), layers = get32(header + 20), faces = get32(header + 24);
+	image->levels = get32(header + 28);
+	unsigned int supercompression = get32(header + 32);
+
+	image->blockBytes = ktxBlockBytes(image->vkFormat);
+	if(image->blockBytes == 0 || depth != 0 || layers != 0 || faces != 1 || supercompression != 0
+		|| image->width <= 0 || image->height <= 0 || image->levels < 1 || image->levels > KTX_MAX_LEVELS
+		|| size < KTX_HEADER_SIZE + (size_t)image->levels*KTX_LEVEL_ENTRY)
+		return false;
+
+	for(int i = 0; i < image->levels; i++){
+		const unsigned char* entry = data + KTX_HEADER_SIZE + i*KTX_LEVEL_ENTRY;
+		unsigned long long offset = get64(entry), length = get64(entry + 8);
+		size_t expected = ktxLevelSize(levelDimension(image->width, i), levelDimension(image->height, i), image->blockBytes);
+		if(length != expected || offset > size || length > size - offset)
+			return false;
+		image->levelOffset[i] = (size_t)offset;
+		image->levelSize[i] = (size_t)length;
+	}
+	image->sourceKey = readSourceKey(data, size);
+	return true;
+}
+
+bool writeKTX2(const char* filename, unsigned int vkFormat, int width, int height, int levels,
+				const unsigned char* const* levelData, const size_t* levelSize, unsigned long long sourceKey)
+{
+	int blockBytes = ktxBlockBytes(vkFormat);
+	if(blockBytes == 0 || levels < 1 || levels > KTX_MAX_LEVELS)
+		return false;
+
+	//BC1 is one colour sample; BC3 an alpha block followed by a colour block
+	bool bc3 = (vkFormat == KTX_FORMAT::BC3_UNORM);
+	int samples = bc3 ? 2 : 1;
+	unsigned int blockSize = 24 + 16*samples;
+	vector<unsigned char> dfd;
+	put32(dfd, 4 + blockSize);
+	put32(dfd, 0);									//Khronos vendor, basic descriptor
+	put32(dfd, 2 | (blockSize << 16));				//Version 2
+	put32(dfd, (bc3 ? DFD_MODEL_BC3 : DFD_MODEL_BC1A) | (DFD_PRIMARIES_BT709 << 8) | (DFD_TRANSFER_LINEAR << 16));
+	put32(dfd, 3 | (3 << 8));						//4x4 texel blocks
+	put32(dfd, blockBytes);
+	put32(dfd, 0);
+	if(bc3){
+		put32(dfd, 0 | (63 << 16) | (DFD_CHANNEL_ALPHA << 24));
+		put32(dfd, 0); put32(dfd, 0); put32(dfd, 0xFFFFFFFF);
+	}
+	put32(dfd, (bc3 ? 64 : 0) | (63 << 16) | (DFD_CHANNEL_COLOR << 24));
+	put32(dfd, 0); put32(dfd, 0); put32(dfd, 0xFFFFFFFF);
+
+	//Key, NUL, hex value, NUL, padded to 4 bytes
+	char value[17];
+	snprintf(value, sizeof(value), "%016llx", sourceKey);
+	vector<unsigned char> kvd;
+	put32(kvd, (unsigned int)(sizeof(KTX_SOURCE_KEY) + sizeof(value)));
+	kvd.insert(kvd.end(), KTX_SOURCE_KEY, KTX_SOURCE_KEY + sizeof(KTX_SOURCE_KEY));
+	kvd.insert(kvd.end(), value, value + sizeof(value));
+	while(kvd.size() % 4)
+		kvd.push_back(0);
+
+	//Levels are stored smallest first, each aligned to the block size
+	size_t dfdOffset = KTX_HEADER_SIZE + (size_t)levels*KTX_LEVEL_ENTRY;
+	size_t kvdOffset = dfdOffset + dfd.size();
+	size_t offsets[KTX_MAX_LEVELS];
+	size_t end = kvdOffset + kvd.size();
+	for(int i = levels - 1; i >= 0; i--){
+		end = (end + blockBytes - 1)/blockBytes*blockBytes;
+		offsets[i] = end;
+		end += levelSize[i];
+	}
+
+	vector<unsigned char> header(identifier, identifier + sizeof(identifier));
+	put32(header, vkFormat);
+	put32(header, 1);				//typeSize is 1 for block formats
+	put32(header, width);
+	put32(header, height);
+	put32(header, 0);				//Depth, layers: a plain 2D texture
+	put32(header, 0);
+	put32(header, 1);				//Faces
+	put32(header, levels);
+	put32(header, 0);				//No supercompression
+	put32(header, (unsigned int)dfdOffset);
+	put32(header, (unsigned int)dfd.size());
+	put32(header, (unsigned int)kvdOffset);
+	put32(header, (unsigned int)kvd.size());
+	put64(header, 0);				//No supercompression global data
+	put64(header, 0);
+	for(int i = 0; i < levels; i++){
+		put64(header, offsets[i]);
+		put64(header, levelSize[i]);
+		put64(header, levelSize[i]);
+	}
+	header.insert(header.end(), dfd.begin(), dfd.end());
+	header.insert(header.end(), kvd.begin(), kvd.end());
+
+	FILE* file = fopen(filename, "wb");
+	if(file == 0)
+		return false;
+	bool ok = fwrite(&header[0], 1, header.size(), file) == header.size();
+	size_t written = header.size();
+	static const unsigned char padding[16] = {};
+	for(int i = levels - 1; i >= 0 && ok; i--){
+		ok = fwrite(padding, 1, offsets[i] - written, file) == offsets[i] - written
+			&& fwrite(levelData[i], 1, levelSize[i], file) == levelSize[i];
+		written = offsets[i] + levelSize[i];
+	}
+	return (fclose(file) == 0) && ok;
+}
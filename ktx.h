@@ -0,0 +1,36 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <cstddef>
+
+#define KTX_MAX_LEVELS 16
+#define KTX_SOURCE_COMPONENTS 4			//texcook decodes to RGBA; the components sourceKey is hashed with
+
+//Vulkan format numbers KTX2 records; only the block formats texcook writes
+struct KTX_FORMAT{
+	enum{BC1_RGB_UNORM=131, BC3_UNORM=137};
+};
+
+//Where each mip level of a KTX2 file sits, level 0 the largest
+struct KTXImage{
+	unsigned int vkFormat;
+	int width, height;
+	int levels;
+	int blockBytes;		//Bytes per 4x4 block
+	size_t levelOffset[KTX_MAX_LEVELS];		//From the start of the file
+	size_t levelSize[KTX_MAX_LEVELS];
+	unsigned long long sourceKey;			//textureCacheKey() of the image it was cooked from, 0 if not recorded
+};
+
+int ktxBlockBytes(unsigned int vkFormat);
+size_t ktxLevelSize(int width, int height, int blockBytes);
+
+//Checks the header and level index against the file size; no pixel data is touched
+bool parseKTX2(const unsigned char* data, size_t size, KTXImage* image);
+
+//levelData[0] is the full size image, each later level half the one before.
+//sourceKey goes in the key/value data so stale files can be told apart
+bool writeKTX2(const char* filename, unsigned int vkFormat, int width, int height, int levels,
+				const unsigned char* const* levelData, const size_t* levelSize, unsigned long long sourceKey);
+
+#endif
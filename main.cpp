@@ -17,6 +17,8 @@
 #include <algorithm>
 #include <vector>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
 
 #include "glm/glm.hpp"
@@ -33,6 +35,24 @@
 #include "stb_image_write.h"
 
 #include "camera.h"
+#include "streambuffer.h"
+#include "mesharena.h"
+#include "culling.h"
+#include "occlusion.h"
+#include "rendertarget.h"
+#include "glsupport.h"
+#include "depthprecision.h"
+#include "input.h"
+#include "dynamicres.h"
+#include "framepacing.h"
+#include "profiler.h"
+#include "alloctracker.h"
+#include "text.h"
+#include "headless.h"
+#include "benchmark.h"
+#include "geometry.h"
+#include "allocators.h"
+#include "texturestream.h"
 
 #define PI 3.14159265359
 
@@ -40,7 +60,7 @@ using namespace std;
 using namespace glm;
 
 //Forward definitions
-bool CheckGLErrors(string location);
+bool CheckGLErrors(const char* location);
 void QueryGLVersion();
 string LoadSource(const string &filename);
 GLuint CompileShader(GLenum shaderType, const string &source);
@@ -51,7 +71,16 @@ bool mousePressed = false;
 bool plsMove = true;
 float speedyG = 60.f;
 int atPlanet = 0;
+#define FOCUS_TRANSITION 0.75		//Seconds to glide between bodies on 1/2/3
 bool restart = false;
+bool swapEarth = false;		//E: stream in the other Earth texture
+double simDays = 0.0;		//Simulated time since the start or the last reset
+bool showHUD = false;		//Performance overlay, toggled with H
+bool hudReady = false;		//A font was found and rasterized
+
+InputQueue inputQueue;
+int windowWidth = 1, windowHeight = 1;		//Cached for cursor normalisation
+bool redraw = true;		//Window contents were lost or never drawn
 
 Camera cam;
 
@@ -67,30 +96,61 @@ void ErrorCallback(int error, const char* description)
     cout << description << endl;
 }
 
-// handles keyboard input events
+// The callbacks only queue events; processInput() applies them once per frame
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	inputKey(inputQueue, key, action);
+}
+
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+	inputButton(inputQueue, button, action);
+}
+
+void mousePosCallback(GLFWwindow* window, double xpos, double ypos)
+{
+	inputMotion(inputQueue, xpos, ypos);
+}
+
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+	inputScroll(inputQueue, xoffset, yoffset);
+}
+
+void resizeCallback(GLFWwindow* window, int width, int height)
+{
+	inputResize(inputQueue, width, height);
+}
+
+void refreshCallback(GLFWwindow* window)
+{
+	inputRefresh(inputQueue);
+}
+
+// handles keyboard input events
+void handleKey(int key, int action)
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GL_TRUE);
     else if (key == GLFW_KEY_1 && action == GLFW_PRESS){
-    	cam.sphereCoords.z = 50.f;
+    	cam.startTransition(50.f, FOCUS_TRANSITION);
     	atPlanet = 0;
     }
     else if (key == GLFW_KEY_2 && action == GLFW_PRESS){
-    	cam.sphereCoords.z = 10.f;
+    	cam.startTransition(10.f, FOCUS_TRANSITION);
     	atPlanet = 1;
     }
     else if (key == GLFW_KEY_3 && action == GLFW_PRESS){
-    	cam.sphereCoords.z = 5.f;
+    	cam.startTransition(5.f, FOCUS_TRANSITION);
     	atPlanet = 2;
     }
-    else if (key == GLFW_KEY_R){
-    	if(action == GLFW_PRESS){
-    		restart = true;
-    	}
-    	else if (action == GLFW_RELEASE){
-    		restart = false;
-    	}
+    else if (key == GLFW_KEY_R && action == GLFW_PRESS)
+    	restart = true;		//Applied, and cleared, by the next frame
+    else if (key == GLFW_KEY_E && action == GLFW_PRESS)
+    	swapEarth = true;
+    else if(key == GLFW_KEY_H && action == GLFW_PRESS){
+    	showHUD = hudReady && !showHUD;
+    	redraw = true;
     }
     else if(key == GLFW_KEY_SPACE && action == GLFW_PRESS)
     	plsMove = !plsMove;
@@ -106,37 +166,47 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
     }
 }
 
-void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+//Per-frame input stage: drains the queue in order and moves the camera once
+//	Cursor motion is normalised against the cached window size, which is what
+//	GLFW reports cursor positions in
+void processInput()
 {
-	if( (action == GLFW_PRESS) || (action == GLFW_RELEASE) )
-		mousePressed = !mousePressed;
-}
-
-void mousePosCallback(GLFWwindow* window, double xpos, double ypos)
-{
-	int vp[4];
-	glGetIntegerv(GL_VIEWPORT, vp);
-
-	vec2 newPos = vec2(xpos/(double)vp[2], -ypos/(double)vp[3])*2.f - vec2(1.f);
-	vec2 diff = newPos - mousePos;
-
-	if(mousePressed)
-		cam.moveCamera(-diff.y, diff.x, 0.f);
-
-	mousePos = newPos;
-}
-
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
-{
-	cam.moveCamera(0.f, 0.f, -yoffset);
-}
-
-void resizeCallback(GLFWwindow* window, int width, int height)
-{
-	int vp[4];
-	glGetIntegerv(GL_VIEWPORT, vp);
+	PROFILE_ZONE("input");
+	vec3 delta = vec3(0.f);		//phi, theta, radius
+	InputEvent event;
+
+	while(inputQueue.pop(&event)){
+		switch(event.type){
+			case InputEvent::KEY :
+				handleKey(event.a, event.b);
+				break;
+			case InputEvent::BUTTON :
+				if( (event.b == GLFW_PRESS) || (event.b == GLFW_RELEASE) )
+					mousePressed = !mousePressed;
+				break;
+			case InputEvent::MOTION : {
+				vec2 newPos = vec2(event.x/(double)windowWidth, -event.y/(double)windowHeight)*2.f - vec2(1.f);
+				vec2 diff = newPos - mousePos;
+				if(mousePressed)
+					delta += vec3(-diff.y, diff.x, 0.f);
+				mousePos = newPos;
+				break;
+			}
+			case InputEvent::SCROLL :
+				delta.z -= event.y;
+				break;
+			case InputEvent::RESIZE :
+				windowWidth = event.a;
+				windowHeight = event.b;
+				break;
+			case InputEvent::REFRESH :
+				redraw = true;
+				break;
+		}
+	}
 
-	glViewport(0, 0, width, height);
+	if(delta != vec3(0.f))
+		cam.moveCamera(delta.x, delta.y, delta.z);
 }
 
 
@@ -155,34 +225,208 @@ vector<vec3> points;
 vector<vec2> uvs;
 
 //Structs are simply acting as namespaces
-//Access the values like so: VAO::LINES
-struct VAO{
-	enum {GEOMETRY=0, COUNT};		//Enumeration assigns each name a value going up
-										//LINES=0, COUNT=1
+//Access the values like so: SHADER::DEFAULT
+struct SHADER{
+	enum {DEFAULT=0, SKY, TEXT, COUNT};		//DEFAULT=0, SKY=1, TEXT=2, COUNT=3
 };
 
-struct VBO{
-	enum {POINTS=0, NORMALS, UVS, INDICES, COUNT};	//POINTS=0, COLOR=1, COUNT=2
+struct UBO{
+	enum {FRAME=0, DRAWS, COUNT};		//Uniform block binding points
 };
 
-struct SHADER{
-	enum {DEFAULT=0, COUNT};		//LINE=0, COUNT=1
+GLuint shader [SHADER::COUNT];		//Array which stores shader program handles
+GLuint skyVAO;		//Empty; the sky triangle comes from gl_VertexID
+
+//Every static mesh lives in one vertex/index buffer pair behind a single VAO
+MeshArena meshes;
+
+//Textures decode on worker threads and upload a slice per frame; bodies
+//	draw a placeholder until theirs lands
+TextureStreamer textures;
+GLsizeiptr textureBudget = TEXTURE_UPLOAD_BUDGET;		//--texture-budget, bytes per frame
+const char* textureCache = "texcache";		//--texture-cache, 0 is off
+const char* earthTextures[2] = {"earthTex.jpg", 0};		//E alternates, --earth-texture sets the second
+int earthTexture = 0;
+
+//Per-frame dynamic data (uniforms, indirect commands) lives in a fenced,
+//	persistently mapped ring so nothing is reallocated while the GPU still reads it
+StreamBuffer frameData;
+
+//Must match the array size of DrawBlock in vertex.glsl
+#define MAX_DRAWS 128
+#define MAX_BATCHES 64		//Single-texture batches per frame; draws past the last are dropped and counted
+
+//Mirrors the std140 FrameBlock uniform block in vertex.glsl and skyVertex.glsl
+struct FrameBlock{
+	mat4 cameraMatrix;
+	mat4 perspectiveMatrix;
+	mat4 skyMatrix;
+	vec4 lightPosition;		//The sun, camera-relative
+	float farDepth;		//Clip-space z of the far plane, where the sky is drawn
+	float padding[3];
 };
 
-GLuint vbo [VBO::COUNT];		//Array which stores OpenGL's vertex buffer object handles
-GLuint vao [VAO::COUNT];		//Array which stores Vertex Array Object handles
-GLuint shader [SHADER::COUNT];		//Array which stores shader program handles
+//Reverse-Z: floating-point depth running from 1 at the near plane to 0 at an
+//	infinitely distant far plane, which keeps precision all the way to the stars.
+//	Needs glClipControl (GL 4.5 / ARB_clip_control); otherwise standard depth is kept
+bool reverseZ = false;
+GLenum depthTest = GL_LEQUAL;
+RenderTarget sceneTarget;		//Float depth and scaled rendering need our own framebuffer
+bool offscreen = false;			//Scene goes through sceneTarget
+DynamicResolution dynamicRes;
+double frameBudget = 0.0;		//Milliseconds of GPU time for --dynamic-resolution, 0 is off
+FramePacer pacer;
+int vsyncMode = VSYNC::ON;
+double fpsCap = 0.0;
+const char* profileFile = 0;	//Chrome trace written on exit with --profile
+
+//--headless: no window, frames are presented into an offscreen target
+bool headless = false;
+int headlessFrames = 0;
+HeadlessContext headlessContext;
+GLuint screenFramebuffer = 0;		//Where finished frames go; 0 is the window
+int screenWidth = 1024, screenHeight = 1024;		//Initial size, --size WxH
+const char* outputFile = 0;		//PNG of the last headless frame
+
+//--benchmark: scripted scenarios, timed and checked against reference images
+bool benchmarking = false;
+Benchmark bench;
+const char* benchScenario = 0;		//0 runs them all
+const char* referenceDir = "reference";
+bool updateReferences = false;		//--update-reference
+const char* resultsFile = "benchmark.json";
+
+//Performance overlay
+TextRenderer text;
+const char* hudFont = 0;		//--hud-font, otherwise the first of hudFonts that loads
+const char* hudFonts[] = {"hudFont.ttf",
+						  "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+						  "/System/Library/Fonts/Menlo.ttc",
+						  "C:/Windows/Fonts/consola.ttf"};
+#define HUD_LINES 5
+#define HUD_REFRESH 0.25		//Seconds between refreshes of the HUD's numbers
+#define HUD_PACING_WINDOW 240	//Recent frames behind the HUD's fps figures; the full history is for the exit report
+char hudLines[HUD_LINES][96];
+double hudUpdated = -HUD_REFRESH;		//Due straight away
+
+//Work the frame handed to GL, for the HUD
+struct FrameCounters{
+	int drawCalls;
+	size_t uploadedBytes;
+};
+FrameCounters frameCounters;
 
-//Gets handles from OpenGL
-void generateIDs()
-{
-	glGenVertexArrays(VAO::COUNT, vao);		//Tells OpenGL to create VAO::COUNT many
-														// Vertex Array Objects, and store their
-														// handles in vao array
-	glGenBuffers(VBO::COUNT, vbo);		//Tells OpenGL to create VBO::COUNT many
-													//Vertex Buffer Objects and store their
-													//handles in vbo array
-}
+//Mirrors one std140 DrawData entry of the DrawBlock array in vertex.glsl
+struct DrawData{
+	mat4 modelviewMatrix;
+	int isDiffuse;
+	int padding[3];
+};
+
+//One body's worth of work for the frame; render() culls and batches these
+struct DrawItem{
+	int mesh;
+	GLuint texture;
+	mat4 modelview;
+	bool diffuse;
+	vec4 bounds;		//World-space bounding sphere (center, radius)
+};
+
+//Transient per-frame data (draw lists, culling arrays, indirect commands) is
+//	carved out of one linear arena that starts over every frame
+#define FRAME_ARENA_SIZE (256*1024)
+#define MAX_QUEUED_DRAWS 1024
+FrameArena frameArena;
+
+DrawItem* drawList;		//Frame arena, until the next beginDraws()
+int drawCount;
+DrawElementsIndirectCommand* drawCommands;
+vec4* drawBounds;
+unsigned char* drawVisible;
+
+//What a body keeps on the CPU once its mesh is uploaded, --mesh-residency
+struct RESIDENCY{
+	enum {GPU_ONLY=0, COLLISION};		//Nothing, or a coarse copy for picking and collision
+};
+int meshResidency = RESIDENCY::GPU_ONLY;
+#define BODY_DIVISIONS 100
+#define COLLISION_DIVISIONS 16
+
+//Vertex arrays a mesh is generated into on its way to the GPU; one shared set,
+//	since static meshes only live in the mesh arena once uploaded
+struct MeshData{
+	vector<vec3> points;
+	vector<vec3> normals;
+	vector<vec2> uvs;
+	vector<unsigned int> indices;
+
+	void clear()
+	{
+		points.clear(); normals.clear(); uvs.clear(); indices.clear();
+	}
+
+	//Gives the memory back; nothing regenerates meshes once the scene is built
+	void release()
+	{
+		vector<vec3>().swap(points);
+		vector<vec3>().swap(normals);
+		vector<vec2>().swap(uvs);
+		vector<unsigned int>().swap(indices);
+	}
+
+	//Exact sizes up front, instead of whatever push_back's doubling lands on
+	void reserveSphere(int divisions)
+	{
+		points.reserve(divisions*divisions);
+		normals.reserve(divisions*divisions);
+		uvs.reserve(divisions*divisions);
+		indices.reserve((divisions - 1)*(divisions - 1)*6);
+	}
+
+	size_t capacityBytes()
+	{
+		return points.capacity()*sizeof(vec3) + normals.capacity()*sizeof(vec3)
+				+ uvs.capacity()*sizeof(vec2) + indices.capacity()*sizeof(unsigned int);
+	}
+};
+MeshData meshScratch;
+
+//A body in the scene; records come from bodyPool, so bodies can be added and
+//	removed at runtime without fragmenting the heap
+struct Body{
+	const char* name;
+	dvec3 center;
+	dmat3 spin;
+	float radius;
+	bool diffuse;
+	int mesh;			//Handle in the mesh arena
+	GLuint texture;
+
+	//Only with RESIDENCY::COLLISION
+	vector<vec3> collisionPoints;
+	vector<unsigned int> collisionIndices;
+};
+
+#define BODY_SLAB 16		//Body records per pool slab
+Pool bodyPool;
+
+//The simulation state R puts back: transforms, time and camera, no meshes
+struct BodyState{
+	dvec3 center;
+	dmat3 spin;
+};
+
+struct SceneSnapshot{
+	vector<BodyState> bodies;
+	dmat3 starSpin;
+	double simDays;
+	Camera camera;
+	int atPlanet;
+};
+SceneSnapshot initialScene;
+
+CullStats cullStats;		//Visible/culled/occluded bodies in the last frame
+OcclusionBuffer occlusion;
 
 //Clean up IDs when you're done using them
 void deleteIDs()
@@ -192,94 +436,71 @@ void deleteIDs()
 		glDeleteProgram(shader[i]);
 	}
 	
-	glDeleteVertexArrays(VAO::COUNT, vao);
-	glDeleteBuffers(VBO::COUNT, vbo);	
-}
-
-
-//Describe the setup of the Vertex Array Object
-bool initVAO()
-{
-	glBindVertexArray(vao[VAO::GEOMETRY]);		//Set the active Vertex Array
-
-	glEnableVertexAttribArray(0);		//Tell opengl you're using layout attribute 0 (For shader input)
-	glBindBuffer( GL_ARRAY_BUFFER, vbo[VBO::POINTS] );		//Set the active Vertex Buffer
-	glVertexAttribPointer(
-		0,				//Attribute
-		3,				//Size # Components
-		GL_FLOAT,	//Type
-		GL_FALSE, 	//Normalized?
-		sizeof(vec3),	//Stride
-		(void*)0			//Offset
-		);
-
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[VBO::NORMALS]);
-	glVertexAttribPointer(
-		1,				//Attribute
-		3,				//Size # Components
-		GL_FLOAT,	//Type
-		GL_FALSE, 	//Normalized?
-		sizeof(vec3),	//Stride
-		(void*)0			//Offset
-		);
-	
-	glEnableVertexAttribArray(2);		//Tell opengl you're using layout attribute 1
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[VBO::UVS]);
-	glVertexAttribPointer(
-		2,
-		2,
-		GL_FLOAT,
-		GL_FALSE,
-		sizeof(vec2),
-		(void*)0
-		);	
+	glDeleteVertexArrays(1, &skyVAO);
+	sceneTarget.destroy();
+	dynamicRes.destroy();
+	meshes.destroy();
+	frameData.destroy();
+	textures.destroy();
+	profiler.destroy();
+	text.destroy();
+}
+
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[VBO::INDICES]);
+//Loads a mesh into the shared arena and returns its handle
+//	Meshes are built around the origin once at startup, so this is
+//	not called per frame - bodies move through their modelview matrix instead
+int loadBuffer(const vector<vec3>& points, const vector<vec3>& normals, 
+				const vector<vec2>& uvs, const vector<unsigned int>& indices)
+{
+	PROFILE_ZONE("loadBuffer");
+	int mesh = meshes.upload(points, normals, uvs, indices);
+	frameCounters.uploadedBytes += points.size()*8*sizeof(float) + indices.size()*sizeof(unsigned int);
 
-	return !CheckGLErrors("initVAO");		//Check for errors in initialize
+	CheckGLErrors("loadBuffer");
+	return mesh;
+}
+
+//(Re)generates a body's sphere around the origin and swaps it into the mesh arena;
+//	the body's center and spin place it
+void buildMesh(Body* body)
+{
+	MeshData& mesh = meshScratch;
+	mesh.clear();
+	mesh.reserveSphere(BODY_DIVISIONS);
+	generateSphere(mesh.points, mesh.normals, mesh.uvs, mesh.indices, body->radius, vec3(0.f), BODY_DIVISIONS);
+	meshes.release(body->mesh);
+	body->mesh = loadBuffer(mesh.points, mesh.normals, mesh.uvs, mesh.indices);
+
+	//CPU-side queries don't need the render tessellation, normals or UVs
+	if(meshResidency == RESIDENCY::COLLISION){
+		mesh.clear();
+		generateSphere(mesh.points, mesh.normals, mesh.uvs, mesh.indices, body->radius, vec3(0.f), COLLISION_DIVISIONS);
+		body->collisionPoints = mesh.points;
+		body->collisionIndices = mesh.indices;
+	}
 }
 
+Body* createBody(const char* name, dvec3 center, float radius, bool diffuse, GLuint texture)
+{
+	Body* body = bodyPool.create<Body>();
+	if(body == 0)
+		return 0;
+	body->name = name;
+	body->center = center;
+	body->spin = dmat3(1.0);
+	body->radius = radius;
+	body->diffuse = diffuse;
+	body->texture = texture;
+	body->mesh = -1;
+	buildMesh(body);
+	return body;
+}
 
-//Loads buffers with data
-bool loadBuffer(const vector<vec3>& points, const vector<vec3> normals, 
-				const vector<vec2>& uvs, const vector<unsigned int>& indices)
+void destroyBody(Body* body)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[VBO::POINTS]);
-	glBufferData(
-		GL_ARRAY_BUFFER,				//Which buffer you're loading too
-		sizeof(vec3)*points.size(),	//Size of data in array (in bytes)
-		&points[0],							//Start of array (&points[0] will give you pointer to start of vector)
-		GL_STATIC_DRAW						//GL_DYNAMIC_DRAW if you're changing the data often
-												//GL_STATIC_DRAW if you're changing seldomly
-		);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[VBO::NORMALS]);
-	glBufferData(
-		GL_ARRAY_BUFFER,				//Which buffer you're loading too
-		sizeof(vec3)*normals.size(),	//Size of data in array (in bytes)
-		&normals[0],							//Start of array (&points[0] will give you pointer to start of vector)
-		GL_STATIC_DRAW						//GL_DYNAMIC_DRAW if you're changing the data often
-												//GL_STATIC_DRAW if you're changing seldomly
-		);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[VBO::UVS]);
-	glBufferData(
-		GL_ARRAY_BUFFER,
-		sizeof(vec2)*uvs.size(),
-		&uvs[0],
-		GL_STATIC_DRAW
-		);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[VBO::INDICES]);
-	glBufferData(
-		GL_ELEMENT_ARRAY_BUFFER,
-		sizeof(unsigned int)*indices.size(),
-		&indices[0],
-		GL_STATIC_DRAW
-		);
-
-	return !CheckGLErrors("loadBuffer");	
+	meshes.release(body->mesh);
+	bodyPool.destroy(body);
 }
 
 //Compile and link shaders, storing the program ID in shader array
@@ -293,43 +514,22 @@ bool initShader()
 	
 	shader[SHADER::DEFAULT] = LinkProgram(vertexID, fragmentID);	//Link and store program ID in shader array
 
-	return !CheckGLErrors("initShader");
-}
+	glUniformBlockBinding(shader[SHADER::DEFAULT],
+						glGetUniformBlockIndex(shader[SHADER::DEFAULT], "FrameBlock"), UBO::FRAME);
+	glUniformBlockBinding(shader[SHADER::DEFAULT],
+						glGetUniformBlockIndex(shader[SHADER::DEFAULT], "DrawBlock"), UBO::DRAWS);
 
-//For reference:
-//	https://open.gl/textures
-GLuint createTexture(const char* filename)
-{
-	int components;
-	GLuint texID;
-	int tWidth, tHeight;
+	vertexID = CompileShader(GL_VERTEX_SHADER, LoadSource("skyVertex.glsl"));
+	fragmentID = CompileShader(GL_FRAGMENT_SHADER, LoadSource("skyFragment.glsl"));
+	shader[SHADER::SKY] = LinkProgram(vertexID, fragmentID);
+	glUniformBlockBinding(shader[SHADER::SKY],
+						glGetUniformBlockIndex(shader[SHADER::SKY], "FrameBlock"), UBO::FRAME);
 
-	//stbi_set_flip_vertically_on_load(true);
-	unsigned char* data = stbi_load(filename, &tWidth, &tHeight, &components, 0);
-	
-	if(data != NULL)
-	{
-		glGenTextures(1, &texID);
-		glBindTexture(GL_TEXTURE_2D, texID);
-
-		if(components==3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tWidth, tHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		else if(components==4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tWidth, tHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		//Clean up
-		glBindTexture(GL_TEXTURE_2D, 0);
-		stbi_image_free(data);
+	vertexID = CompileShader(GL_VERTEX_SHADER, LoadSource("textVertex.glsl"));
+	fragmentID = CompileShader(GL_FRAGMENT_SHADER, LoadSource("textFragment.glsl"));
+	shader[SHADER::TEXT] = LinkProgram(vertexID, fragmentID);
 
-		return texID;
-	} 
-	
-	return 0;	//Error
+	return !CheckGLErrors("initShader");
 }
 
 //Use program before loading texture
@@ -346,327 +546,809 @@ bool loadTexture(GLuint texID, GLuint texUnit, GLuint program, const char* unifo
 }
 
 
-void generateSphere(vector<vec3>& positions, vector<vec3>& normals, 
-					vector<vec2>& uvs, vector<unsigned int>& indices,
-					float radius, vec3 center, int divisions)
+//Size of whatever frames are presented to: the window or the headless target
+void getScreenSize(int* width, int* height)
+{
+	if(headless){
+		*width = headlessContext.target.width;
+		*height = headlessContext.target.height;
+	}
+	else
+		glfwGetFramebufferSize(window, width, height);
+}
+
+//Writes the screen framebuffer to a PNG, bottom row last
+bool saveScreenshot(const char* filename, int width, int height)
+{
+	vector<unsigned char> pixels(width*height*3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, screenFramebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	//GL rows run bottom-up, so hand stb the last row with a negative stride
+	bool saved = stbi_write_png(filename, width, height, 3, &pixels[(height - 1)*width*3], -width*3) != 0;
+	cout << (saved ? "Saved " : "Could not save ") << filename << endl;
+	return saved;
+}
+
+//Initialization
+void initGL()
 {
-	float step = 1.f/(float)(divisions-1);
+	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-	float phi = 0.f;
-	vec3 pos;
+	//Only call these once - don't call again every time you change geometry
+	initShader();		//Create shader and store program ID
 
-	//Traversing phi
-	for(int i=0; i<divisions; i++) {
-		float theta = 0.f;
+	glGenVertexArrays(1, &skyVAO);
 
-		//Traversing v
-		for(int j=0; j<divisions; j++) {
-			pos = radius * vec3(cos(2.f * PI * theta) * sin(PI * phi),
-								sin(2.f * PI * theta) * sin(PI * phi),
-								cos(PI * phi)) + center;
+	//Room for a few 100x100 spheres before the arena has to grow
+	meshes.init(64*1024, 384*1024, MAX_DRAWS);
 
-			vec3 normal = normalize(pos - center);
-			
-			positions.push_back(pos);
-			normals.push_back(normal);
-			uvs.push_back(vec2(theta, phi));
+	//Three frames in flight, each with room for the frame block, every batch's
+	//	fully backed DrawBlock and a command for every queued draw, plus padding
+	GLint uniformAlignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	GLsizeiptr regionSize = sizeof(FrameBlock) + MAX_BATCHES*MAX_DRAWS*sizeof(DrawData)
+							+ MAX_QUEUED_DRAWS*sizeof(DrawElementsIndirectCommand) + (2*MAX_BATCHES + 1)*uniformAlignment;
+	frameData.init(GL_UNIFORM_BUFFER, regionSize, 3, uniformAlignment);
 
-			theta += step;
-		}
-		phi += step;
+	if(!textures.init(textureBudget, textureCache))
+		cout << "Texture upload ring unavailable, uploading textures from client memory" << endl;
+
+	reverseZ = hasGLVersion(4, 5) || hasGLExtension("GL_ARB_clip_control");
+	if(reverseZ){
+		glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+		glClearDepth(0.0);
+		depthTest = GL_GREATER;
 	}
 
-	for(int i=0; i<divisions-1; i++)
-	{
-		for(int j=0; j<divisions-1; j++)
-		{
-			unsigned int p00 = i*divisions+j;
-			unsigned int p01 = i*divisions+j+1;
-			unsigned int p10 = (i+1)*divisions + j;
-			unsigned int p11 = (i+1)*divisions + j + 1;
-
-			indices.push_back(p00);
-			indices.push_back(p10);
-			indices.push_back(p01);
-
-			indices.push_back(p01);
-			indices.push_back(p10);
-			indices.push_back(p11);
+	if(frameBudget > 0.0)
+		dynamicRes.init(frameBudget, 0.5f, 1.f);
+
+	offscreen = reverseZ || dynamicRes.enabled;
+	if(offscreen){
+		int width, height;
+		getScreenSize(&width, &height);
+		sceneTarget.init(width, height, reverseZ ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24);
+	}
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(depthTest);
+}
+
+//Reverse-Z projection for glClipControl's zero-to-one range with no far plane:
+//	depth = zNear / distance, so 1 at the near plane and 0 at infinity
+mat4 reverseInfinitePerspective(float fovy, float aspect, float zNear)
+{
+	float f = 1.f/tan(fovy/2.f);
+
+	mat4 projection(0.f);
+	projection[0][0] = f/aspect;
+	projection[1][1] = f;
+	projection[2][3] = -1.f;
+	projection[3][2] = zNear;
+	return projection;
+}
+
+//Scene projection for a framebuffer of the given size, so nothing stretches
+mat4 sceneProjection(int width, int height)
+{
+	float aspect = (height > 0) ? width/(float)height : 1.f;
+	//float fovy, float aspect, float zNear, float zFar
+	return reverseZ ? reverseInfinitePerspective(radians(60.f), aspect, 0.1f)
+					: perspective(radians(60.f), aspect, 0.1f, 10000.f);
+}
+
+//Reports how full and how fragmented the mesh arena is
+void printArenaStats()
+{
+	ArenaStats stats = meshes.stats();
+	cout << "Mesh arena: " << stats.meshes << " meshes, "
+		 << stats.vertexUsed << "/" << stats.vertexCapacity << " vertices ("
+		 << stats.vertexFreeBlocks << " free blocks, " << 100.f*stats.vertexFragmentation << "% fragmented), "
+		 << stats.indexUsed << "/" << stats.indexCapacity << " indices ("
+		 << stats.indexFreeBlocks << " free blocks, " << 100.f*stats.indexFragmentation << "% fragmented)" << endl;
+}
+
+//Starts this frame's draw list in the frame arena; call after frameArena.reset()
+void beginDraws()
+{
+	drawList = frameArena.allocate<DrawItem>(MAX_QUEUED_DRAWS);
+	drawCount = 0;
+}
+
+//Queues a body for this frame's render()
+void pushDraw(int mesh, GLuint texture, mat4 modelview, bool diffuse, vec3 center, float radius)
+{
+	if(drawList == 0 || drawCount == MAX_QUEUED_DRAWS)
+		return;
+	DrawItem& item = drawList[drawCount++];
+	item.mesh = mesh;
+	item.texture = texture;
+	item.modelview = modelview;
+	item.diffuse = diffuse;
+	item.bounds = vec4(center, radius);
+}
+
+void captureScene(SceneSnapshot& snapshot, Body** bodies, int count, const dmat3& starSpin)
+{
+	snapshot.bodies.resize(count);
+	for(int i = 0; i < count; i++){
+		snapshot.bodies[i].center = bodies[i]->center;
+		snapshot.bodies[i].spin = bodies[i]->spin;
+	}
+	snapshot.starSpin = starSpin;
+	snapshot.simDays = simDays;
+	snapshot.camera = cam;
+	snapshot.atPlanet = atPlanet;
+}
+
+//O(bodies); meshes and textures are untouched
+void restoreScene(const SceneSnapshot& snapshot, Body** bodies, int count, dmat3& starSpin)
+{
+	for(int i = 0; i < count && i < (int)snapshot.bodies.size(); i++){
+		bodies[i]->center = snapshot.bodies[i].center;
+		bodies[i]->spin = snapshot.bodies[i].spin;
+	}
+	starSpin = snapshot.starSpin;
+	simDays = snapshot.simDays;
+	cam = snapshot.camera;
+	cam.dirty = true;
+	atPlanet = snapshot.atPlanet;
+	redraw = true;
+}
+
+//Bytes of a texture across its mip levels, from the sizes GL reports for it
+size_t textureBytes(GLuint texture)
+{
+	size_t bytes = 0;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	for(int level = 0; ; level++){
+		GLint width = 0, height = 0, compressed = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+		if(width == 0 || height == 0)
+			break;
+
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+		if(compressed){
+			GLint size = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			bytes += size;
+			continue;
 		}
+		GLint bits = 0, channel;
+		GLenum sizes[4] = {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE};
+		for(int i = 0; i < 4; i++){
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, sizes[i], &channel);
+			bits += channel;
+		}
+		bytes += (size_t)width*height*bits/8;
 	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return bytes;
 }
 
-//Initialization
-void initGL()
+//Where each body's memory is: its record and any collision copy on the CPU,
+//	its mesh and texture on the GPU
+void printBodyMemory(Body** bodies, int count)
 {
-	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	cout << "Body memory (KB):   CPU   GPU mesh   GPU texture" << endl;
+	for(int i = 0; i < count; i++){
+		Body* body = bodies[i];
+		size_t cpu = bodyPool.slotSize + body->collisionPoints.capacity()*sizeof(vec3)
+						+ body->collisionIndices.capacity()*sizeof(unsigned int);
+		printf("  %-12s %9.1f %10.1f %13.1f\n", body->name, cpu/1024.0,
+				meshes.meshBytes(body->mesh)/1024.0, textureBytes(body->texture)/1024.0);
+	}
+	printf("  %-12s %9.1f\n", "mesh scratch", meshScratch.capacityBytes()/1024.0);
+}
 
-	//Only call these once - don't call again every time you change geometry
-	generateIDs();		//Create VertexArrayObjects and Vertex Buffer Objects and store their handles
-	initShader();		//Create shader and store program ID
+//Queues a body, placed relative to the frame's floating origin
+void pushBody(const Body* body, dvec3 origin)
+{
+	pushDraw(body->mesh, body->texture, bodyMatrix(body->center, body->spin, origin), body->diffuse,
+			vec3(body->center - origin), body->radius);
+}
 
-	initVAO();			//Describe setup of Vertex Array Objects and Vertex Buffer Object
+//Compacts drawList (and drawBounds) down to the entries marked in drawVisible
+void keepVisibleDraws()
+{
+	int kept = 0;
+	for(int i = 0; i < drawCount; i++){
+		if(drawVisible[i]){
+			drawList[kept] = drawList[i];
+			drawBounds[kept] = drawBounds[i];
+			kept++;
+		}
+	}
+	drawCount = kept;
+}
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
+//Drops queued bodies that are outside the view frustum, then those hidden
+//	behind the largest bodies on screen
+void cullDraws(const mat4& cameraMatrix, const mat4& perspectiveMatrix)
+{
+	PROFILE_ZONE("cull");
+	Frustum frustum;
+	extractFrustum(perspectiveMatrix * cameraMatrix, frustum, reverseZ);
+
+	drawBounds = frameArena.allocate<vec4>(drawCount);
+	drawVisible = frameArena.allocate<unsigned char>(drawCount);
+	if(drawBounds == 0 || drawVisible == 0){
+		drawCount = 0;
+		return;
+	}
+	for(int i = 0; i < drawCount; i++)
+		drawBounds[i] = drawList[i].bounds;
+
+	int count = drawCount;
+	int inFrustum = count ? cullSpheres(frustum, drawBounds, count, drawVisible) : 0;
+	cullStats.culled = count - inFrustum;
+	keepVisibleDraws();
+
+	occlusion.begin(cameraMatrix, perspectiveMatrix);
+	cullStats.visible = inFrustum ? occlusion.cull(drawBounds, inFrustum, drawVisible) : 0;
+	cullStats.occluded = inFrustum - cullStats.visible;
+	keepVisibleDraws();
 }
 
-//Draws buffers to screen
-void render(Camera* cam, mat4 perspectiveMatrix, mat4 modelview, int startElement, int numElements)
+//Stable insertion sort by texture; the list is a handful of bodies, and
+//stable_sort would take a temporary buffer from the heap every frame
+void sortByTexture(DrawItem* draws, int count)
 {
-	
-	//Don't need to call these on every draw, so long as they don't change
-	glUseProgram(shader[SHADER::DEFAULT]);		//Use LINE program
-	glBindVertexArray(vao[VAO::GEOMETRY]);		//Use the LINES vertex array
+	for(int i = 1; i < count; i++){
+		DrawItem item = draws[i];
+		int j = i;
+		for(; j > 0 && draws[j - 1].texture > item.texture; j--)
+			draws[j] = draws[j - 1];
+		draws[j] = item;
+	}
+}
 
-	mat4 camMatrix = cam->getMatrix();
+//Draws the star background as one fullscreen triangle on the far plane
+//	Drawn after the bodies so depth-equal testing shades only uncovered pixels
+void renderSky(GLuint skyTexture)
+{
+	PROFILE_GPU_ZONE("sky");
+	glUseProgram(shader[SHADER::SKY]);
+	glBindVertexArray(skyVAO);
+	loadTexture(skyTexture, GL_TEXTURE0, shader[SHADER::SKY], "sphereTex");
+
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(depthTest);
+
+	CheckGLErrors("renderSky");
+}
 
-	glUniformMatrix4fv(glGetUniformLocation(shader[SHADER::DEFAULT], "cameraMatrix"),
-						1,
-						false,
-						&camMatrix[0][0]);
+//Draws everything queued with pushDraw() to screen, then the sky
+//	Uniforms and indirect commands are written straight into the mapped ring,
+//	then each run of draws sharing a texture goes out as one multi-draw
+//	Everything is camera-relative: bodies were queued relative to the eye and
+//	cameraMatrix is the view rotation only, shared by every draw this frame
+void render(mat4 cameraMatrix, mat4 perspectiveMatrix, vec3 lightPosition, mat3 skySpin, GLuint skyTexture)
+{
+	PROFILE_ZONE("render");
+	//Culled bodies never reach the ring or the GPU
+	cullDraws(cameraMatrix, perspectiveMatrix);
+	sortByTexture(drawList, drawCount);
+
+	frameData.beginFrame();
+
+	GLintptr frameOffset;
+	FrameBlock* frame = (FrameBlock*)frameData.allocate(sizeof(FrameBlock), &frameOffset);
+	if(frame == 0){
+		frameData.endFrame();
+		cullStats.dropped = drawCount;
+		drawCount = 0;
+		return;
+	}
+	frame->cameraMatrix = cameraMatrix;
+	frame->perspectiveMatrix = perspectiveMatrix;
+	//View ray -> world, then world -> the star map's spun frame
+	frame->skyMatrix = mat4(transpose(skySpin) * transpose(mat3(cameraMatrix)));
+	frame->lightPosition = vec4(lightPosition, 1.f);
+	frame->farDepth = reverseZ ? 0.f : 1.f;
+
+	//Each batch is at most MAX_DRAWS draws with a single texture
+	struct Batch{
+		GLuint texture;
+		GLintptr drawOffset, commandOffset;
+		int firstCommand, count;
+	};
+	Batch batches[MAX_BATCHES];
+	int numBatches = 0;
+
+	drawCommands = frameArena.allocate<DrawElementsIndirectCommand>(drawCount);
+	int numCommands = 0;
+	int next = 0;
+	while(next < drawCount && drawCommands && numBatches < MAX_BATCHES){
+		Batch& batch = batches[numBatches];
+		batch.texture = drawList[next].texture;
+		batch.firstCommand = numCommands;
+		batch.count = 0;
+
+		//The whole declared DrawBlock array has to be backed, even if partly used
+		DrawData* draws = (DrawData*)frameData.allocate(MAX_DRAWS*sizeof(DrawData), &batch.drawOffset);
+		if(draws == 0)
+			break;
+
+		while(next < drawCount && batch.count < MAX_DRAWS && drawList[next].texture == batch.texture){
+			draws[batch.count].modelviewMatrix = drawList[next].modelview;
+			draws[batch.count].isDiffuse = drawList[next].diffuse;
+			drawCommands[numCommands++] = meshes.command(drawList[next].mesh, batch.count);
+			batch.count++;
+			next++;
+		}
 
-	glUniformMatrix4fv(glGetUniformLocation(shader[SHADER::DEFAULT], "perspectiveMatrix"),
-						1,
-						false,
-						&perspectiveMatrix[0][0]);
+		void* commands = frameData.allocate(batch.count*sizeof(DrawElementsIndirectCommand), &batch.commandOffset);
+		if(commands == 0)
+			break;
+		memcpy(commands, &drawCommands[batch.firstCommand], batch.count*sizeof(DrawElementsIndirectCommand));
 
-	glUniformMatrix4fv(glGetUniformLocation(shader[SHADER::DEFAULT], "modelviewMatrix"),
-						1,
-						false,
-						&modelview[0][0]);
-	
-	CheckGLErrors("loadUniforms");
+		numBatches++;
+	}
+	//A partly filled batch that ran out of ring space was never submitted
+	int submitted = 0;
+	for(int i = 0; i < numBatches; i++)
+		submitted += batches[i].count;
+	cullStats.dropped = drawCount - submitted;
+
+	frameData.flush();
 
-	glDrawElements(
-			GL_TRIANGLES,		//What shape we're drawing	- GL_TRIANGLES, GL_LINES, GL_POINTS, GL_QUADS, GL_TRIANGLE_STRIP
-			numElements,		//How many indices
-			GL_UNSIGNED_INT,	//Type
-			(void*)0			//Offset
-			);
+	//Don't need to call these on every draw, so long as they don't change
+	glUseProgram(shader[SHADER::DEFAULT]);		//Use LINE program
+	glBindBufferRange(GL_UNIFORM_BUFFER, UBO::FRAME, frameData.buffer, frameOffset, sizeof(FrameBlock));
+
+	{
+		PROFILE_GPU_ZONE("bodies");
+		for(int i = 0; i < numBatches; i++){
+			loadTexture(batches[i].texture, GL_TEXTURE0, shader[SHADER::DEFAULT], "sphereTex");
+			glBindBufferRange(GL_UNIFORM_BUFFER, UBO::DRAWS, frameData.buffer, batches[i].drawOffset, MAX_DRAWS*sizeof(DrawData));
+			meshes.multiDraw(frameData.buffer, batches[i].commandOffset, &drawCommands[batches[i].firstCommand], batches[i].count);
+			frameCounters.drawCalls += meshes.multiDrawIndirect ? 1 : batches[i].count;
+		}
+	}
 
 	CheckGLErrors("render");
-}
 
-void rotate(vector<vec3>& positions, vector<vec3>& normals, vec3 spherePos, vec3 axis, float angle)
-{
-    axis = normalize(axis);
-    float x = axis.x;
-    float y = axis.y;
-    float z = axis.z;
-    float x2 = x * x;
-    float y2 = y * y;
-    float z2 = z * z;
-    float s = sin(angle);
-    float c = cos(angle);
-    float oc = 1.0 - c;
-    
-    mat3 rotationMatrix = mat3(	c + x2*oc,	x*y*oc - z*s,	x*z*oc + y*s,
-    							y*x*oc + z*s,	c + y2*oc,	y*z*oc - x*s,
-    							z*x*oc - y*s,	z*y*oc + x*s,	c + z2*oc);
-
-	for (unsigned i = 0; i < positions.size(); i++){
-    	positions[i] = ((positions[i] - spherePos) * rotationMatrix) + spherePos;
-    	normals[i] = normalize(positions[i] - spherePos);
-    }
+	renderSky(skyTexture);
+	frameCounters.drawCalls++;
+
+	frameCounters.uploadedBytes += frameData.head;
+	frameData.endFrame();
+	drawCount = 0;
 }
 
-void orbit(vector<vec3>& positions, vector<vec3>& normals, vec3 parentSphere, vec3 &spherePos, vec3 axis, float angle)
+//Rasterizes the HUD font at a size that looks the same on high-DPI screens
+void initHUD()
 {
-	axis = normalize(axis);
-    float x = axis.x;
-    float y = axis.y;
-    float z = axis.z;
-    float x2 = x * x;
-    float y2 = y * y;
-    float z2 = z * z;
-    float s = sin(angle);
-    float c = cos(angle);
-    float oc = 1.0 - c;
-    
-    rotate(positions, normals, spherePos, axis, -angle);
+	int pixelSize = 16;
+	if(!headless){
+		int windowW, windowH, framebufferW, framebufferH;
+		glfwGetWindowSize(window, &windowW, &windowH);
+		glfwGetFramebufferSize(window, &framebufferW, &framebufferH);
+		if(windowW > 0)
+			pixelSize = 16*framebufferW/windowW;
+	}
 
-    mat3 rotationMatrix = mat3(	c + x2*oc,	x*y*oc - z*s,	x*z*oc + y*s,
-    							y*x*oc + z*s,	c + y2*oc,	y*z*oc - x*s,
-    							z*x*oc - y*s,	z*y*oc + x*s,	c + z2*oc);
+	if(hudFont)
+		hudReady = text.init(shader[SHADER::TEXT], hudFont, pixelSize);
+	for(unsigned i = 0; !hudFont && i < sizeof(hudFonts)/sizeof(hudFonts[0]); i++){
+		FILE* file = fopen(hudFonts[i], "rb");
+		if(file == 0)
+			continue;
+		fclose(file);
+		hudFont = hudFonts[i];
+		hudReady = text.init(shader[SHADER::TEXT], hudFont, pixelSize);
+	}
 
-   	spherePos = ((spherePos - parentSphere) * rotationMatrix) + parentSphere;
-	
-	for (unsigned i = 0; i < positions.size(); i++){
-    	positions[i] = ((positions[i] - parentSphere) * rotationMatrix) + parentSphere;
-    	normals[i] = normalize(positions[i] - spherePos);
-    }
+	if(!hudReady)
+		cout << "HUD disabled: no usable font (try --hud-font)" << endl;
+	showHUD = showHUD && hudReady;
 }
 
+//Overlay of frame timing and per-frame work, drawn straight to the window
+//	The numbers are only reformatted every HUD_REFRESH seconds; in between the
+//	cost is queueing the cached lines and a single draw
+void drawHUD(int width, int height)
+{
+	PROFILE_ZONE("hud");
+	PROFILE_GPU_ZONE("hud");
+
+	double now = clockSeconds();
+	if(now - hudUpdated >= HUD_REFRESH){
+		hudUpdated = now;
+		PacingStats stats = pacer.stats(HUD_PACING_WINDOW);
+		double last = (pacer.count > 0) ? pacer.intervals[(pacer.count - 1) % PACING_HISTORY] : 0.0;
+
+		snprintf(hudLines[0], sizeof(hudLines[0]), "frame %.2f ms  mean %.2f ms", last*1e3, stats.mean*1e3);
+		if(stats.frames > 0)
+			snprintf(hudLines[1], sizeof(hudLines[1]), "fps median %.0f  5%% low %.0f  1%% low %.0f",
+					1.0/stats.p50, 1.0/stats.p95, 1.0/stats.p99);
+		else
+			snprintf(hudLines[1], sizeof(hudLines[1]), "fps -");
+		snprintf(hudLines[2], sizeof(hudLines[2]), "draws %d  bodies %d shown %d culled %d occluded %d dropped",
+				frameCounters.drawCalls, cullStats.visible, cullStats.culled, cullStats.occluded, cullStats.dropped);
+		snprintf(hudLines[3], sizeof(hudLines[3]), "upload %.1f KB/frame", frameCounters.uploadedBytes/1024.0);
+		snprintf(hudLines[4], sizeof(hudLines[4]), "day %.1f  warp %.3f days/frame%s", simDays, 1.0/speedyG, plsMove ? "" : "  (paused)");
+	}
+
+	float y = 8.f;
+	for(int i = 0; i < HUD_LINES; i++){
+		text.print(9.f, y + 1.f, hudLines[i], vec4(0.f, 0.f, 0.f, 0.8f));		//Drop shadow
+		text.print(8.f, y, hudLines[i], vec4(1.f, 1.f, 0.7f, 1.f));
+		y += text.lineHeight;
+	}
+
+	glViewport(0, 0, width, height);
+	text.draw(width, height);
+}
 
 // ==========================================================================
 // PROGRAM ENTRY POINT
 
 int main(int argc, char *argv[])
 {   
-    // initialize the GLFW windowing system
-    if (!glfwInit()) {
-        cout << "ERROR: GLFW failed to initilize, TERMINATING" << endl;
-        return -1;
-    }
-    glfwSetErrorCallback(ErrorCallback);
-
-    // attempt to create a window with an OpenGL 4.1 core profile context
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    window = glfwCreateWindow(1024, 1024, "CPSC 453 OpenGL Boilerplate", 0, 0);
-    if (!window) {
-        cout << "Program failed to create GLFW window, TERMINATING" << endl;
-        glfwTerminate();
-        return -1;
-    }
+	for(int i=1; i<argc; i++){
+		string arg = argv[i];
+
+		//Depth error table for both depth conventions, no window needed
+		if(arg == "--depth-precision"){
+			reportDepthPrecision(0.1f, 10000.f, 5000.f);
+			return 0;
+		}
+		else if(arg == "--dynamic-resolution"){
+			frameBudget = 12.0;
+			if(i + 1 < argc && atof(argv[i + 1]) > 0.0)
+				frameBudget = atof(argv[++i]);
+		}
+		else if(arg == "--vsync" && i + 1 < argc){
+			string mode = argv[++i];
+			vsyncMode = (mode == "off") ? VSYNC::OFF : (mode == "adaptive") ? VSYNC::ADAPTIVE : VSYNC::ON;
+		}
+		else if(arg == "--fps" && i + 1 < argc)
+			fpsCap = atof(argv[++i]);
+		else if(arg == "--hud")
+			showHUD = true;
+		else if(arg == "--hud-font" && i + 1 < argc)
+			hudFont = argv[++i];
+		else if(arg == "--headless"){
+			headless = true;
+			headlessFrames = 300;
+			if(i + 1 < argc && atoi(argv[i + 1]) > 0)
+				headlessFrames = atoi(argv[++i]);
+		}
+		else if(arg == "--size" && i + 1 < argc)
+			sscanf(argv[++i], "%dx%d", &screenWidth, &screenHeight);
+		else if(arg == "--output" && i + 1 < argc)
+			outputFile = argv[++i];
+		else if(arg == "--benchmark"){
+			benchmarking = true;
+			if(i + 1 < argc && argv[i + 1][0] != '-')
+				benchScenario = argv[++i];
+		}
+		else if(arg == "--reference" && i + 1 < argc)
+			referenceDir = argv[++i];
+		else if(arg == "--update-reference")
+			updateReferences = true;
+		else if(arg == "--results" && i + 1 < argc)
+			resultsFile = argv[++i];
+		else if(arg == "--texture-budget" && i + 1 < argc)
+			textureBudget = (GLsizeiptr)atoi(argv[++i])*1024;
+		else if(arg == "--texture-cache" && i + 1 < argc){
+			textureCache = argv[++i];
+			if(string(textureCache) == "off")
+				textureCache = 0;
+		}
+		else if(arg == "--earth-texture" && i + 1 < argc)
+			earthTextures[1] = argv[++i];
+		else if(arg == "--mesh-residency" && i + 1 < argc)
+			meshResidency = (string(argv[++i]) == "collision") ? RESIDENCY::COLLISION : RESIDENCY::GPU_ONLY;
+		else if(arg == "--profile"){
+			profileFile = "profile.json";
+			if(i + 1 < argc && argv[i + 1][0] != '-')
+				profileFile = argv[++i];
+		}
+	}
+
+	//Measure the renderer alone: no window, no overlay, no vsync, fixed resolution
+	if(benchmarking){
+		headless = true;
+		showHUD = false;
+		frameBudget = 0.0;
+		vsyncMode = VSYNC::OFF;
+		fpsCap = 0.0;
+	}
 
-    // set keyboard callback function and make our context current (active)
-    glfwSetKeyCallback(window, keyCallback);
-    glfwSetMouseButtonCallback(window, mouseButtonCallback);
-    glfwSetCursorPosCallback(window, mousePosCallback);
-  	glfwSetScrollCallback(window, scroll_callback);
-    glfwSetWindowSizeCallback(window, resizeCallback);
-    glfwMakeContextCurrent(window);
+	if(headless){
+		//Same renderer, but no window system at all
+		if(!headlessContext.init(screenWidth, screenHeight)){
+			cout << "ERROR: could not create a headless GL context, TERMINATING" << endl;
+			return -1;
+		}
+		screenFramebuffer = headlessContext.target.framebuffer;
+	}
+	else{
+	    // initialize the GLFW windowing system
+	    if (!glfwInit()) {
+	        cout << "ERROR: GLFW failed to initilize, TERMINATING" << endl;
+	        return -1;
+	    }
+	    glfwSetErrorCallback(ErrorCallback);
+
+	    // attempt to create a window with an OpenGL 4.1 core profile context
+	    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+	    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	    window = glfwCreateWindow(screenWidth, screenHeight, "CPSC 453 OpenGL Boilerplate", 0, 0);
+	    if (!window) {
+	        cout << "Program failed to create GLFW window, TERMINATING" << endl;
+	        glfwTerminate();
+	        return -1;
+	    }
+
+	    // set keyboard callback function and make our context current (active)
+	    glfwSetKeyCallback(window, keyCallback);
+	    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+	    glfwSetCursorPosCallback(window, mousePosCallback);
+	  	glfwSetScrollCallback(window, scroll_callback);
+	    glfwSetWindowSizeCallback(window, resizeCallback);
+	    glfwSetWindowRefreshCallback(window, refreshCallback);
+	    glfwMakeContextCurrent(window);
+	    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+	}
 
     // query and print out information about our OpenGL environment
     QueryGLVersion();
 
 	initGL();
-
-	// Sun Data
-	vector<vec3> sunPoints;
-	vector<vec3> sunNormals;
-	vector<vec2> sunUvs;
-	vector<unsigned int> sunIndices;
-	vec3 sunCenter = vec3(0.f);
-	float sunRadius = 8.8f;
-	bool sunDiffuse = false;
-
-	// Earth Data
-	vector<vec3> earthPoints;
-	vector<vec3> earthNormals;
-	vector<vec2> earthUvs;
-	vector<unsigned int> earthIndices;
-	vec3 earthCenter = sunCenter + vec3(18.f,0.f,0.f);
-	float earthRadius = 3.6f;
-	bool earthDiffuse = true;
-
-	// Moon Data
-	vector<vec3> moonPoints;
-	vector<vec3> moonNormals;
-	vector<vec2> moonUvs;
-	vector<unsigned int> moonIndices;
-	vec3 moonCenter = earthCenter + vec3(9.f,0.f,0.f);
-	float moonRadius = 1.4f;
-	bool moonDiffuse = true;
-
-	// Star Data
-	vector<vec3> starPoints;
-	vector<vec3> starNormals;
-	vector<vec2> starUvs;
-	vector<unsigned int> starIndices;
-	vec3 starCenter = vec3(0.f,0.f,0.f);
-	float starRadius = 5000.f;
-	bool starDiffuse = false;
-
-	generateSphere(sunPoints, sunNormals, sunUvs, sunIndices, sunRadius, sunCenter, 100);
-	GLuint sunPic = createTexture("sunTex.jpg");
-	generateSphere(earthPoints, earthNormals, earthUvs, earthIndices, earthRadius, earthCenter, 100);
-	GLuint earthPic = createTexture("earthTex.jpg");
-	generateSphere(moonPoints, moonNormals, moonUvs, moonIndices, moonRadius, moonCenter, 100);
-	GLuint moonPic = createTexture("moonTex.jpg");
-	generateSphere(starPoints, starNormals, starUvs, starIndices, starRadius, starCenter, 100);
-	GLuint starPic = createTexture("starTex.png");
-
-	cam = Camera(vec3(PI/2, PI/2, 50.f), sunCenter, sunRadius);
-	//float fovy, float aspect, float zNear, float zFar
-	mat4 perspectiveMatrix = perspective(radians(60.f), 1.f, 0.1f, 10000.f);
+	pacer.init(vsyncMode, fpsCap, !headless);
+	if(profileFile)
+		profiler.init(true);
+	initHUD();
+	if(benchmarking && !bench.init(benchScenario, referenceDir, updateReferences))
+		return -1;
+
+	frameArena.init("frame", FRAME_ARENA_SIZE);
+	bodyPool.init("bodies", sizeof(Body), ALLOC_SIMD_ALIGN, BODY_SLAB);
+
+	Body* sun = createBody("sun", dvec3(0.0), 8.8f, false, 0);
+	Body* earth = createBody("earth", sun->center + dvec3(18.0,0.0,0.0), 3.6f, true, 0);
+	Body* moon = createBody("moon", earth->center + dvec3(9.0,0.0,0.0), 1.4f, true, 0);
+	Body* bodies[] = {sun, earth, moon};
+	const int bodyCount = sizeof(bodies)/sizeof(bodies[0]);
+
+	// Star Data (background only, drawn by renderSky())
+	dmat3 starSpin = dmat3(1.0);
+	GLuint starPic = 0;
+
+	textures.request("sunTex.jpg", &sun->texture);
+	textures.request(earthTextures[earthTexture], &earth->texture);
+	textures.request("moonTex.jpg", &moon->texture);
+	textures.request("starTex.png", &starPic);
+	if(headless)
+		textures.finish();		//Saved frames and benchmarks never show placeholders
+	meshScratch.release();
+	printArenaStats();
+	bool memoryReported = false;		//Once the textures are in
+
+	cam = Camera(vec3(PI/2, PI/2, 50.f), sun->center, sun->radius);
+	captureScene(initialScene, bodies, bodyCount, starSpin);
+	mat4 perspectiveMatrix;
+	int projectionWidth = 0, projectionHeight = 0;
+	double lastTime = clockSeconds();
 	
-    // run an event-triggered main loop
-    while (!glfwWindowShouldClose(window))
+    // run an event-triggered main loop; headless runs a fixed number of frames
+    int framesDrawn = 0;
+    while (benchmarking ? !bench.done() : headless ? framesDrawn < headlessFrames : !glfwWindowShouldClose(window))
     {
-    	glClearColor(0.f, 0.f, 0.f, 0.f);		//Color to clear the screen with (R, G, B, Alpha)
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);		//Clear color and depth buffers (Haven't covered yet)
+		PROFILE_ZONE("frame");
+		double frameStart = clockSeconds();
+
+		//The script drives the same state the keyboard and mouse do
+		if(benchmarking){
+			BenchmarkAction action = bench.action();
+			//Restored here rather than through restart so the frame's own
+			//camera move lands on the reset scene
+			if(action.reset){
+				restoreScene(initialScene, bodies, bodyCount, starSpin);
+				speedyG = 60.f;
+				plsMove = true;
+			}
+			if(action.key){
+				inputKey(inputQueue, action.key, GLFW_PRESS);
+				inputKey(inputQueue, action.key, GLFW_RELEASE);
+			}
+			if(action.cameraDelta != vec3(0.f))
+				cam.moveCamera(action.cameraDelta.x, action.cameraDelta.y, action.cameraDelta.z);
+		}
+		processInput();
+
+		int width, height;
+		getScreenSize(&width, &height);
+		if(width != projectionWidth || height != projectionHeight){
+			perspectiveMatrix = sceneProjection(width, height);
+			projectionWidth = width;
+			projectionHeight = height;
+			redraw = true;
+		}
+
+		if(swapEarth){
+			if(earthTextures[1]){
+				earthTexture = 1 - earthTexture;
+				textures.request(earthTextures[earthTexture], &earth->texture);
+			}
+			swapEarth = false;
+		}
+		if(textures.update())
+			redraw = true;
+		if(!memoryReported && textures.idle()){
+			printBodyMemory(bodies, bodyCount);
+			memoryReported = true;
+		}
 
 		if(restart){
-			sunPoints.clear(); sunNormals.clear(); sunUvs.clear(); sunIndices.clear(); sunRadius = 8.8f; sunCenter = vec3(0.f);
-			generateSphere(sunPoints, sunNormals, sunUvs, sunIndices, sunRadius, sunCenter, 100);
-			earthPoints.clear(); earthNormals.clear(); earthUvs.clear(); earthIndices.clear(); earthRadius = 3.6f; earthCenter = sunCenter + vec3(18.f,0.f,0.f);
-			generateSphere(earthPoints, earthNormals, earthUvs, earthIndices, earthRadius, earthCenter, 100);
-			moonPoints.clear(); moonNormals.clear(); moonUvs.clear(); moonIndices.clear(); moonRadius = 1.4f; moonCenter = earthCenter + vec3(9.f,0.f,0.f);
-			generateSphere(moonPoints, moonNormals, moonUvs, moonIndices, moonRadius, moonCenter, 100);
-			starPoints.clear(); starNormals.clear(); starUvs.clear(); starIndices.clear(); starRadius = 5000.f; starCenter = vec3(0.f,0.f,0.f);
-			generateSphere(starPoints, starNormals, starUvs, starIndices, starRadius, starCenter, 100);
+			PROFILE_ZONE("reset");
+			restoreScene(initialScene, bodies, bodyCount, starSpin);
+			restart = false;
 		}
 		
 		if (plsMove){
-			float sunRot = (2 * PI / 26.24f) / speedyG;
-			float earthRot = (2 * PI / 365.25f) / speedyG;
-			float earthDay = (2 * PI / 1.f) / speedyG;
-			float moonRot = (2 * PI / 27.322f) / speedyG;
-			float starRot = (2 * PI / 3600.f) / speedyG;
-			rotate(sunPoints, sunNormals, sunCenter, vec3(0,0,1), sunRot);
-			orbit(earthPoints, earthNormals, sunCenter, earthCenter, vec3(0,0,1), earthRot);
-			rotate(earthPoints, earthNormals, earthCenter, vec3(0, 0, 1), earthDay);
-			orbit(moonPoints, moonNormals, earthCenter, moonCenter, vec3(0,0,1), moonRot);
-			rotate(moonPoints, moonNormals, moonCenter, vec3(0, 0, 1), moonRot);
-			rotate(starPoints, starNormals, starCenter, vec3(0,0,1), starRot);
+			PROFILE_ZONE("simulate");
+			double sunRot = (2 * PI / 26.24f) / speedyG;
+			double earthRot = (2 * PI / 365.25f) / speedyG;
+			double earthDay = (2 * PI / 1.f) / speedyG;
+			double moonRot = (2 * PI / 27.322f) / speedyG;
+			double starRot = (2 * PI / 3600.f) / speedyG;
+			rotate(sun->spin, dvec3(0,0,1), sunRot);
+			orbit(sun->center, earth->center, dvec3(0,0,1), earthRot);
+			rotate(earth->spin, dvec3(0, 0, 1), earthDay);
+			orbit(earth->center, moon->center, dvec3(0,0,1), moonRot);
+			rotate(moon->spin, dvec3(0, 0, 1), moonRot);
+			rotate(starSpin, dvec3(0,0,1), starRot);
+			simDays += 1.0/speedyG;
 		}
 
+		double now = clockSeconds();
+		cam.update(benchmarking ? 1.0/60.0 : now - lastTime);		//Fixed step keeps benchmark frames reproducible
+		lastTime = now;
+
+		//Only marks the camera dirty when the focus body actually moved
 		switch (atPlanet){
 			case 0 :
-				cam = Camera(cam.sphereCoords, -sunCenter, sunRadius);
+				cam.setTarget(-sun->center, sun->radius);
 				break;
 			case 1 :
-				cam = Camera(cam.sphereCoords, -earthCenter, earthRadius);
+				cam.setTarget(-earth->center, earth->radius);
 				break;
 			case 2 :
-			   	cam = Camera(cam.sphereCoords, -moonCenter, moonRadius);
+			   	cam.setTarget(-moon->center, moon->radius);
 			   	break;
 		}
 
-		glUseProgram(shader[SHADER::DEFAULT]);
+		//Paused and nothing moved: the last frame is still on screen, so sleep
+		//until an event arrives instead of drawing it again
+		if(!headless && !redraw && !plsMove && !restart && !cam.dirty && !cam.transitioning && textures.idle()){
+			PROFILE_ZONE("idle");
+			glfwWaitEvents();
+			lastTime = clockSeconds();
+			pacer.resync();
+			//Closed here too, or the idle pass is charged to the next drawn frame
+			profiler.endFrame();
+			allocations.endFrame();
+			continue;
+		}
+		redraw = false;
+		frameCounters.drawCalls = 0;
+		frameCounters.uploadedBytes = 0;
+
+		if(offscreen){
+			sceneTarget.resize(width, height);
+			if(dynamicRes.enabled)
+				sceneTarget.setViewSize((int)(width*dynamicRes.scale + 0.5f), (int)(height*dynamicRes.scale + 0.5f));
+			sceneTarget.bind();
+		}
+		else{
+			glBindFramebuffer(GL_FRAMEBUFFER, screenFramebuffer);
+			glViewport(0, 0, width, height);
+		}
+		dynamicRes.begin();
+		if(benchmarking)
+			bench.gpuBegin();
+
+    	glClearColor(0.f, 0.f, 0.f, 0.f);		//Color to clear the screen with (R, G, B, Alpha)
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);		//Clear color and depth buffers (Haven't covered yet)
 
-        loadBuffer(sunPoints, sunNormals, sunUvs, sunIndices);
-		loadTexture(sunPic, GL_TEXTURE0, shader[SHADER::DEFAULT], "sphereTex");
-		GLuint uniformLocation = glGetUniformLocation(shader[SHADER::DEFAULT], "isDiffuse");
-		glUniform1i(uniformLocation, sunDiffuse);
-		render(&cam, perspectiveMatrix, mat4(1.f), 0, sunIndices.size());
+		//Floating origin: this frame's world is re-centred on the eye
+		dvec3 origin = cam.getEye();
 
-        loadBuffer(earthPoints, earthNormals, earthUvs, earthIndices);
-		loadTexture(earthPic, GL_TEXTURE0, shader[SHADER::DEFAULT], "sphereTex");
-		uniformLocation = glGetUniformLocation(shader[SHADER::DEFAULT], "isDiffuse");
-		glUniform1i(uniformLocation, earthDiffuse);
-        render(&cam, perspectiveMatrix, mat4(1.f), 0, earthIndices.size());
+		//Last frame's transient data is dead; the lists start over
+		frameArena.reset();
+		beginDraws();
+		for(int i = 0; i < bodyCount; i++)
+			pushBody(bodies[i], origin);
 
-		loadBuffer(moonPoints, moonNormals, moonUvs, moonIndices);
-		loadTexture(moonPic, GL_TEXTURE0, shader[SHADER::DEFAULT], "sphereTex");
-		uniformLocation = glGetUniformLocation(shader[SHADER::DEFAULT], "isDiffuse");
-		glUniform1i(uniformLocation, moonDiffuse);
-		render(&cam, perspectiveMatrix, mat4(1.f), 0, moonIndices.size());
+		render(cam.getRotationMatrix(), perspectiveMatrix, vec3(sun->center - origin), mat3(starSpin), starPic);
 
-		loadBuffer(starPoints, starNormals, starUvs, starIndices);
-		loadTexture(starPic, GL_TEXTURE0, shader[SHADER::DEFAULT], "sphereTex");
-		uniformLocation = glGetUniformLocation(shader[SHADER::DEFAULT], "isDiffuse");
-		glUniform1i(uniformLocation, starDiffuse);
-		render(&cam, perspectiveMatrix, mat4(1.f), 0, starIndices.size());
+		dynamicRes.end();
+
+		//Scaled-down frames are stretched back up with a bilinear blit
+		if(offscreen){
+			PROFILE_GPU_ZONE("upscale");
+			bool scaled = sceneTarget.viewWidth != width || sceneTarget.viewHeight != height;
+			sceneTarget.blitToScreen(screenFramebuffer, width, height, scaled ? GL_LINEAR : GL_NEAREST);
+		}
+		dynamicRes.update();
+
+		if(showHUD)
+			drawHUD(width, height);
+		double cpuSeconds = clockSeconds() - frameStart;
+		if(benchmarking)
+			bench.gpuEnd();
 
         // scene is rendered to the back buffer, so swap to front for display
-        glfwSwapBuffers(window);
+        pacer.wait();
+        if(!headless){
+        	PROFILE_ZONE("swap");
+        	glfwSwapBuffers(window);
+        }
+        else
+        	glFlush();
+        pacer.frameDone();
+        profiler.endFrame();
+        allocations.endFrame();
+        framesDrawn++;
+
+        if(benchmarking && bench.endFrame(cpuSeconds, clockSeconds()))
+        	bench.capture(screenFramebuffer, width, height);
+
+        // pick up events without waiting, something is still moving
+        if(!headless)
+        	glfwPollEvents();
+	}
 
-        // sleep until next event before drawing again
-        glfwPollEvents();
+	pacer.report();
+	printMemoryReport();
+	textures.report();
+	allocations.report();
+	if(profileFile)
+		profiler.writeTrace(profileFile);
+
+	bool passed = true;
+	if(benchmarking){
+		int width, height;
+		getScreenSize(&width, &height);
+		bench.writeResults(resultsFile, (const char*)glGetString(GL_RENDERER), width, height);
+		passed = bench.passed();
+		bench.destroy();
+	}
+
+	if(headless && outputFile){
+		int width, height;
+		getScreenSize(&width, &height);
+		saveScreenshot(outputFile, width, height);
 	}
 
 	// clean up allocated resources before exit
+	for(int i = 0; i < bodyCount; i++)
+		destroyBody(bodies[i]);
+	bodyPool.destroy();
+	frameArena.destroy();
    	deleteIDs();
-	glfwDestroyWindow(window);
-   	glfwTerminate();
+	if(headless)
+		headlessContext.destroy();
+	else{
+		glfwDestroyWindow(window);
+	   	glfwTerminate();
+	}
 
-   	return 0;
+   	return passed ? 0 : 1;
 }
 
 // ==========================================================================
@@ -687,7 +1369,7 @@ void QueryGLVersion()
          << "on renderer [ " << renderer << " ]" << endl;
 }
 
-bool CheckGLErrors(string location)
+bool CheckGLErrors(const char* location)
 {
     bool error = false;
     for (GLenum flag = glGetError(); flag != GL_NO_ERROR; flag = glGetError())
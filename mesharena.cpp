@@ -0,0 +1,325 @@
+#include "mesharena.h"
+#include "glsupport.h"
+#include <algorithm>
+
+using namespace std;
+
+#define ARENA_VERTEX_FLOATS 8		//position(3), normal(3), uv(2)
+
+RangeAllocator::RangeAllocator():	capacity(0), used(0)
+{}
+
+void RangeAllocator::reset(GLuint _capacity)
+{
+	capacity = _capacity;
+	used = 0;
+	freeBlocks.clear();
+	if(capacity > 0){
+		Block all = {0, capacity};
+		freeBlocks.push_back(all);
+	}
+}
+
+//Appends [capacity, newCapacity) as free space
+void RangeAllocator::grow(GLuint newCapacity)
+{
+	GLuint oldCapacity = capacity;
+	capacity = newCapacity;
+	used += newCapacity - oldCapacity;		//release() takes it back off
+	release(oldCapacity, newCapacity - oldCapacity);
+}
+
+bool RangeAllocator::allocate(GLuint size, GLuint* offset)
+{
+	for(unsigned i = 0; i < freeBlocks.size(); i++){
+		if(freeBlocks[i].size >= size){
+			*offset = freeBlocks[i].offset;
+			freeBlocks[i].offset += size;
+			freeBlocks[i].size -= size;
+			if(freeBlocks[i].size == 0)
+				freeBlocks.erase(freeBlocks.begin() + i);
+			used += size;
+			return true;
+		}
+	}
+	return false;
+}
+
+void RangeAllocator::release(GLuint offset, GLuint size)
+{
+	if(size == 0)
+		return;
+
+	unsigned i = 0;
+	while(i < freeBlocks.size() && freeBlocks[i].offset < offset)
+		i++;
+
+	Block block = {offset, size};
+	freeBlocks.insert(freeBlocks.begin() + i, block);
+	used -= size;
+
+	//Merge with the following block, then with the preceding one
+	if(i+1 < freeBlocks.size() && freeBlocks[i].offset + freeBlocks[i].size == freeBlocks[i+1].offset){
+		freeBlocks[i].size += freeBlocks[i+1].size;
+		freeBlocks.erase(freeBlocks.begin() + i + 1);
+	}
+	if(i > 0 && freeBlocks[i-1].offset + freeBlocks[i-1].size == freeBlocks[i].offset){
+		freeBlocks[i-1].size += freeBlocks[i].size;
+		freeBlocks.erase(freeBlocks.begin() + i);
+	}
+}
+
+GLuint RangeAllocator::largestFree()
+{
+	GLuint largest = 0;
+	for(unsigned i = 0; i < freeBlocks.size(); i++)
+		largest = std::max(largest, freeBlocks[i].size);
+	return largest;
+}
+
+float RangeAllocator::fragmentation()
+{
+	GLuint totalFree = capacity - used;
+	if(totalFree == 0)
+		return 0.f;
+	return 1.f - (float)largestFree()/(float)totalFree;
+}
+
+MeshArena::MeshArena():	vao(0),
+						vertexBuffer(0),
+						indexBuffer(0),
+						drawIDBuffer(0),
+						multiDrawIndirect(false)
+{}
+
+bool MeshArena::init(GLuint vertexCapacity, GLuint indexCapacity, GLuint maxDraws)
+{
+	multiDrawIndirect = hasGLVersion(4, 3) ||
+						(hasGLExtension("GL_ARB_multi_draw_indirect") && hasGLExtension("GL_ARB_base_instance"));
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vertexBuffer);
+	glGenBuffers(1, &indexBuffer);
+	glGenBuffers(1, &drawIDBuffer);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity*ARENA_VERTEX_FLOATS*sizeof(float), 0, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, indexCapacity*sizeof(GLuint), 0, GL_STATIC_DRAW);
+
+	//Instanced attribute holding 0, 1, 2... so baseInstance selects the draw's uniforms
+	vector<GLint> drawIDs(maxDraws);
+	for(GLuint i = 0; i < maxDraws; i++)
+		drawIDs[i] = i;
+	glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+	glBufferData(GL_ARRAY_BUFFER, maxDraws*sizeof(GLint), &drawIDs[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	vertices.reset(vertexCapacity);
+	indices.reset(indexCapacity);
+	meshes.clear();
+
+	describeVertices();
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void MeshArena::destroy()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	glDeleteBuffers(1, &drawIDBuffer);
+	vao = vertexBuffer = indexBuffer = drawIDBuffer = 0;
+}
+
+//Describe the interleaved layout; repeated whenever a buffer is replaced by growing
+void MeshArena::describeVertices()
+{
+	GLsizei stride = ARENA_VERTEX_FLOATS*sizeof(float);
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3*sizeof(float)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6*sizeof(float)));
+
+	//Without base instance support the draw index is set as a constant attribute per draw
+	if(multiDrawIndirect){
+		glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+		glEnableVertexAttribArray(3);
+		glVertexAttribIPointer(3, 1, GL_INT, sizeof(GLint), (void*)0);
+		glVertexAttribDivisor(3, 1);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//Replaces buffer with one of newBytes, keeping the first oldBytes
+void growBuffer(GLuint& buffer, GLsizeiptr oldBytes, GLsizeiptr newBytes)
+{
+	GLuint bigger;
+	glGenBuffers(1, &bigger);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+	glBufferData(GL_COPY_WRITE_BUFFER, newBytes, 0, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, &buffer);
+	buffer = bigger;
+}
+
+void MeshArena::growVertices(GLuint needed)
+{
+	GLuint newCapacity = std::max(vertices.capacity*2, vertices.capacity + needed);
+	growBuffer(vertexBuffer, vertices.capacity*ARENA_VERTEX_FLOATS*sizeof(float),
+				newCapacity*ARENA_VERTEX_FLOATS*sizeof(float));
+	vertices.grow(newCapacity);
+	describeVertices();
+}
+
+void MeshArena::growIndices(GLuint needed)
+{
+	GLuint newCapacity = std::max(indices.capacity*2, indices.capacity + needed);
+	growBuffer(indexBuffer, indices.capacity*sizeof(GLuint), newCapacity*sizeof(GLuint));
+	indices.grow(newCapacity);
+	describeVertices();
+}
+
+//Copies a mesh into the arena and returns its handle
+int MeshArena::upload(const vector<vec3>& points, const vector<vec3>& normals,
+						const vector<vec2>& uvs, const vector<unsigned int>& meshIndices)
+{
+	Mesh mesh;
+	mesh.vertexCount = points.size();
+	mesh.indexCount = meshIndices.size();
+	mesh.live = true;
+
+	//Nothing to draw: a handle over empty ranges, which release() skips
+	if(mesh.vertexCount == 0 || mesh.indexCount == 0){
+		mesh.baseVertex = mesh.vertexCount = 0;
+		mesh.firstIndex = mesh.indexCount = 0;
+		return addMesh(mesh);
+	}
+
+	if(!vertices.allocate(mesh.vertexCount, &mesh.baseVertex)){
+		growVertices(mesh.vertexCount);
+		vertices.allocate(mesh.vertexCount, &mesh.baseVertex);
+	}
+	if(!indices.allocate(mesh.indexCount, &mesh.firstIndex)){
+		growIndices(mesh.indexCount);
+		indices.allocate(mesh.indexCount, &mesh.firstIndex);
+	}
+
+	//Interleaved copy for the upload only; freed on return so no CPU copy of
+	//	the mesh outlives it
+	vector<float> scratch(mesh.vertexCount*ARENA_VERTEX_FLOATS);
+	for(unsigned i = 0; i < mesh.vertexCount; i++){
+		float* v = &scratch[i*ARENA_VERTEX_FLOATS];
+		v[0] = points[i].x;		v[1] = points[i].y;		v[2] = points[i].z;
+		v[3] = normals[i].x;	v[4] = normals[i].y;	v[5] = normals[i].z;
+		v[6] = uvs[i].x;		v[7] = uvs[i].y;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER,
+					mesh.baseVertex*ARENA_VERTEX_FLOATS*sizeof(float),
+					scratch.size()*sizeof(float),
+					scratch.data());
+	glBindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER,
+					mesh.firstIndex*sizeof(GLuint),
+					mesh.indexCount*sizeof(GLuint),
+					meshIndices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return addMesh(mesh);
+}
+
+//Reuses a released slot so handles stay small
+int MeshArena::addMesh(const Mesh& mesh)
+{
+	for(unsigned i = 0; i < meshes.size(); i++){
+		if(!meshes[i].live){
+			meshes[i] = mesh;
+			return i;
+		}
+	}
+	meshes.push_back(mesh);
+	return meshes.size() - 1;
+}
+
+void MeshArena::release(int mesh)
+{
+	if(mesh < 0 || mesh >= (int)meshes.size() || !meshes[mesh].live)
+		return;
+
+	vertices.release(meshes[mesh].baseVertex, meshes[mesh].vertexCount);
+	indices.release(meshes[mesh].firstIndex, meshes[mesh].indexCount);
+	meshes[mesh].live = false;
+}
+
+DrawElementsIndirectCommand MeshArena::command(int mesh, GLuint drawIndex)
+{
+	DrawElementsIndirectCommand cmd;
+	cmd.count = meshes[mesh].indexCount;
+	cmd.instanceCount = 1;
+	cmd.firstIndex = meshes[mesh].firstIndex;
+	cmd.baseVertex = meshes[mesh].baseVertex;
+	cmd.baseInstance = drawIndex;
+	return cmd;
+}
+
+//Submits count commands; on GL 4.3 they are read from indirectBuffer at offset,
+//otherwise the CPU copy is walked with one glDrawElementsBaseVertex each
+void MeshArena::multiDraw(GLuint indirectBuffer, GLintptr offset, const DrawElementsIndirectCommand* commands, int count)
+{
+	glBindVertexArray(vao);
+
+	if(multiDrawIndirect){
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)offset, count, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		return;
+	}
+
+	for(int i = 0; i < count; i++){
+		glVertexAttribI1i(3, commands[i].baseInstance);
+		glDrawElementsBaseVertex(GL_TRIANGLES, commands[i].count, GL_UNSIGNED_INT,
+								(void*)(commands[i].firstIndex*sizeof(GLuint)), commands[i].baseVertex);
+	}
+}
+
+//GPU memory a live mesh occupies in the shared buffers
+size_t MeshArena::meshBytes(int mesh)
+{
+	if(mesh < 0 || mesh >= (int)meshes.size() || !meshes[mesh].live)
+		return 0;
+	return meshes[mesh].vertexCount*ARENA_VERTEX_FLOATS*sizeof(float) + meshes[mesh].indexCount*sizeof(GLuint);
+}
+
+ArenaStats MeshArena::stats()
+{
+	ArenaStats s;
+	s.meshes = 0;
+	for(unsigned i = 0; i < meshes.size(); i++)
+		s.meshes += meshes[i].live;
+	s.vertexCapacity = vertices.capacity;
+	s.vertexUsed = vertices.used;
+	s.indexCapacity = indices.capacity;
+	s.indexUsed = indices.used;
+	s.vertexFreeBlocks = vertices.freeBlocks.size();
+	s.indexFreeBlocks = indices.freeBlocks.size();
+	s.vertexFragmentation = vertices.fragmentation();
+	s.indexFragmentation = indices.fragmentation();
+	return s;
+}
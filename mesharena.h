@@ -0,0 +1,100 @@
+#ifndef MESHARENA_H
+#define MESHARENA_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include "glm/glm.hpp"
+
+using namespace glm;
+
+//Layout of glMultiDrawElementsIndirect commands
+struct DrawElementsIndirectCommand{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+//First-fit free list over [0, capacity), coalescing neighbours on release
+class RangeAllocator{
+public:
+	struct Block{
+		GLuint offset;
+		GLuint size;
+	};
+
+	std::vector<Block> freeBlocks;		//Sorted by offset
+	GLuint capacity;
+	GLuint used;
+
+	RangeAllocator();
+
+	void reset(GLuint _capacity);
+	void grow(GLuint newCapacity);
+	bool allocate(GLuint size, GLuint* offset);
+	void release(GLuint offset, GLuint size);
+
+	GLuint largestFree();
+	float fragmentation();
+};
+
+struct ArenaStats{
+	GLuint meshes;
+	GLuint vertexCapacity, vertexUsed;
+	GLuint indexCapacity, indexUsed;
+	GLuint vertexFreeBlocks, indexFreeBlocks;
+	float vertexFragmentation;		//1 - largest free block / total free space
+	float indexFragmentation;
+};
+
+/*
+	Every static mesh suballocated out of one vertex buffer and one index
+	buffer behind a single VAO. Meshes are addressed by handle; a draw is an
+	indirect command using the mesh's baseVertex/firstIndex, and baseInstance
+	carries the draw's index into the per-draw uniform array.
+*/
+class MeshArena{
+public:
+	struct Mesh{
+		GLuint baseVertex, vertexCount;
+		GLuint firstIndex, indexCount;
+		bool live;
+	};
+
+	GLuint vao;
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+	GLuint drawIDBuffer;
+	RangeAllocator vertices;
+	RangeAllocator indices;
+	std::vector<Mesh> meshes;
+	bool multiDrawIndirect;
+
+	MeshArena();
+
+	bool init(GLuint vertexCapacity, GLuint indexCapacity, GLuint maxDraws);
+	void destroy();
+
+	int upload(const std::vector<vec3>& points, const std::vector<vec3>& normals,
+				const std::vector<vec2>& uvs, const std::vector<unsigned int>& indices);
+	void release(int mesh);
+
+	DrawElementsIndirectCommand command(int mesh, GLuint drawIndex);
+	void multiDraw(GLuint indirectBuffer, GLintptr offset, const DrawElementsIndirectCommand* commands, int count);
+
+	ArenaStats stats();
+	size_t meshBytes(int mesh);
+
+private:
+	void growVertices(GLuint needed);
+	void growIndices(GLuint needed);
+	void describeVertices();
+	int addMesh(const Mesh& mesh);
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "occlusion.h"
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+OcclusionBuffer::OcclusionBuffer():	xScale(1.f), yScale(1.f), occluders(0)
+{}
+
+void OcclusionBuffer::begin(const mat4& cameraMatrix, const mat4& perspectiveMatrix)
+{
+	view = cameraMatrix;
+	xScale = perspectiveMatrix[0][0];
+	yScale = perspectiveMatrix[1][1];
+	occluders = 0;
+
+	for(int i = 0; i < OCCLUSION_WIDTH*OCCLUSION_HEIGHT; i++)
+		depth[i] = FLT_MAX;
+}
+
+//Writes min(depth, z) over [x0, x1] of one row
+void spanMin(float* row, int x0, int x1, float z)
+{
+	int x = x0;
+#ifdef OCCLUSION_SSE
+	__m128 zz = _mm_set1_ps(z);
+	for(; x + 3 <= x1; x += 4)
+		_mm_storeu_ps(row + x, _mm_min_ps(_mm_loadu_ps(row + x), zz));
+#endif
+	for(; x <= x1; x++)
+		row[x] = (row[x] < z) ? row[x] : z;
+}
+
+//True if any pixel of [x0, x1] of one row is at or beyond z
+bool spanReaches(const float* row, int x0, int x1, float z)
+{
+	int x = x0;
+#ifdef OCCLUSION_SSE
+	__m128 zz = _mm_set1_ps(z);
+	for(; x + 3 <= x1; x += 4){
+		if(_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), zz)))
+			return true;
+	}
+#endif
+	for(; x <= x1; x++){
+		if(row[x] >= z)
+			return true;
+	}
+	return false;
+}
+
+bool OcclusionBuffer::addOccluder(vec4 sphere)
+{
+	vec3 v = vec3(view * vec4(vec3(sphere), 1.f));
+	float r = sphere.w;
+	float zc = -v.z;
+
+	//Must sit entirely in front of the camera; a sphere around the camera hides nothing
+	if(zc - r <= 0.f || dot(v, v) <= r*r)
+		return false;
+
+	//The cross-section disk at the center's depth projects to an exact ellipse;
+	//shrinking it by a pixel's half-diagonal keeps only fully covered pixels
+	float cx = (xScale*v.x/zc*0.5f + 0.5f)*OCCLUSION_WIDTH;
+	float cy = (yScale*v.y/zc*0.5f + 0.5f)*OCCLUSION_HEIGHT;
+	float rx = xScale*r/zc*0.5f*OCCLUSION_WIDTH - 0.71f;
+	float ry = yScale*r/zc*0.5f*OCCLUSION_HEIGHT - 0.71f;
+	if(rx <= 0.f || ry <= 0.f)
+		return false;
+
+	int y0 = std::max(0, (int)ceilf(cy - ry - 0.5f));
+	int y1 = std::min(OCCLUSION_HEIGHT - 1, (int)floorf(cy + ry - 0.5f));
+	for(int y = y0; y <= y1; y++){
+		float dy = (y + 0.5f - cy)/ry;
+		if(dy*dy > 1.f)
+			continue;
+		float half = rx*sqrtf(1.f - dy*dy);
+		int x0 = std::max(0, (int)ceilf(cx - half - 0.5f));
+		int x1 = std::min(OCCLUSION_WIDTH - 1, (int)floorf(cx + half - 0.5f));
+		if(x0 <= x1)
+			spanMin(&depth[y*OCCLUSION_WIDTH], x0, x1, zc);
+	}
+
+	occluders++;
+	return true;
+}
+
+bool OcclusionBuffer::visible(vec4 sphere)
+{
+	vec3 v = vec3(view * vec4(vec3(sphere), 1.f));
+	float r = sphere.w;
+	float zNear = -v.z - r;
+	float zFar = -v.z + r;
+
+	if(zNear <= 0.f)
+		return true;
+
+	//Screen bounds of the sphere's view-space bounding box
+	float xLo = std::min((v.x - r)/zNear, (v.x - r)/zFar)*xScale;
+	float xHi = std::max((v.x + r)/zNear, (v.x + r)/zFar)*xScale;
+	float yLo = std::min((v.y - r)/zNear, (v.y - r)/zFar)*yScale;
+	float yHi = std::max((v.y + r)/zNear, (v.y + r)/zFar)*yScale;
+
+	int x0 = std::max(0, (int)floorf((xLo*0.5f + 0.5f)*OCCLUSION_WIDTH));
+	int x1 = std::min(OCCLUSION_WIDTH - 1, (int)floorf((xHi*0.5f + 0.5f)*OCCLUSION_WIDTH));
+	int y0 = std::max(0, (int)floorf((yLo*0.5f + 0.5f)*OCCLUSION_HEIGHT));
+	int y1 = std::min(OCCLUSION_HEIGHT - 1, (int)floorf((yHi*0.5f + 0.5f)*OCCLUSION_HEIGHT));
+	if(x0 > x1 || y0 > y1)
+		return true;
+
+	for(int y = y0; y <= y1; y++){
+		if(spanReaches(&depth[y*OCCLUSION_WIDTH], x0, x1, zNear))
+			return true;
+	}
+	return false;
+}
+
+int OcclusionBuffer::cull(const vec4* spheres, int count, unsigned char* visibleOut)
+{
+	//Rank by projected size (radius over distance) and keep the biggest few
+	int picked[OCCLUSION_MAX_OCCLUDERS];
+	float pickedSize[OCCLUSION_MAX_OCCLUDERS];
+	int numPicked = 0;
+	float minSize = OCCLUSION_MIN_OCCLUDER_PIXELS/(0.5f*OCCLUSION_WIDTH*xScale);
+
+	for(int i = 0; i < count; i++){
+		float zc = -(view * vec4(vec3(spheres[i]), 1.f)).z;
+		if(zc <= spheres[i].w)
+			continue;
+		float size = spheres[i].w/zc;
+		if(size < minSize)
+			continue;
+
+		int slot = numPicked;
+		if(numPicked == OCCLUSION_MAX_OCCLUDERS){
+			slot = 0;
+			for(int j = 1; j < numPicked; j++){
+				if(pickedSize[j] < pickedSize[slot])
+					slot = j;
+			}
+			if(pickedSize[slot] >= size)
+				continue;
+		}
+		else
+			numPicked++;
+		picked[slot] = i;
+		pickedSize[slot] = size;
+	}
+
+	for(int i = 0; i < numPicked; i++)
+		addOccluder(spheres[picked[i]]);
+
+	int numVisible = 0;
+	for(int i = 0; i < count; i++){
+		visibleOut[i] = (occluders == 0) || visible(spheres[i]);
+		numVisible += visibleOut[i];
+	}
+	return numVisible;
+}
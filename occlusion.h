@@ -0,0 +1,39 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "glm/glm.hpp"
+
+using namespace glm;
+
+#define OCCLUSION_WIDTH 128		//Multiple of 4 so rows split evenly into SIMD lanes
+#define OCCLUSION_HEIGHT 128
+#define OCCLUSION_MAX_OCCLUDERS 8
+#define OCCLUSION_MIN_OCCLUDER_PIXELS 4.f		//Smaller disks hide too little to be worth drawing
+
+/*
+	Coarse CPU depth buffer holding linear view depth. The largest bodies on
+	screen are drawn as their central cross-section disk, which every sphere
+	fully covers from the camera's side, so the buffer never claims more
+	than the real geometry hides. Remaining bodies are rejected when the
+	nearest point of their sphere is behind every covered pixel of their
+	screen bounds. Pure CPU, so headless runs cull exactly the same way.
+*/
+class OcclusionBuffer{
+public:
+	float depth[OCCLUSION_WIDTH*OCCLUSION_HEIGHT];
+	mat4 view;
+	float xScale, yScale;
+	int occluders;
+
+	OcclusionBuffer();
+
+	void begin(const mat4& cameraMatrix, const mat4& perspectiveMatrix);
+	bool addOccluder(vec4 sphere);
+	bool visible(vec4 sphere);
+
+	//Picks the largest on-screen spheres as occluders, then tests all of them;
+	//writes 1/0 per sphere and returns the number still visible
+	int cull(const vec4* spheres, int count, unsigned char* visibleOut);
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "profiler.h"
+#include "glsupport.h"
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+Profiler profiler;
+
+static const chrono::steady_clock::time_point profileEpoch = chrono::steady_clock::now();
+
+//Small per-thread ids for the trace; the first thread to ask is 1
+int profileTrack()
+{
+	static atomic<int> nextTrack(PROFILE_GPU_TRACK + 1);
+	static thread_local int track = nextTrack.fetch_add(1);
+	return track;
+}
+
+Profiler::Profiler():	enabled(false),
+						head(0),
+						gpuTimers(false),
+						gpuOffset(0.0),
+						gpuFrame(0)
+{
+	for(int i=0; i<PROFILE_GPU_FRAMES; i++)
+		gpuCount[i] = 0;
+}
+
+//Needs a current context when gpu is set
+void Profiler::init(bool gpu)
+{
+	enabled = true;
+	profileTrack();		//Claim track 1 for the calling thread
+
+	gpuTimers = gpu && (hasGLVersion(3, 3) || hasGLExtension("GL_ARB_timer_query"));
+	if(!gpuTimers)
+		return;
+
+	for(int i=0; i<PROFILE_GPU_FRAMES; i++){
+		glGenQueries(PROFILE_GPU_ZONES*2, gpuQueries[i]);
+		gpuCount[i] = 0;
+	}
+
+	GLint64 gpuNow;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	gpuOffset = now() - gpuNow*1e-9;
+}
+
+void Profiler::destroy()
+{
+	if(gpuTimers){
+		for(int i=0; i<PROFILE_GPU_FRAMES; i++)
+			glDeleteQueries(PROFILE_GPU_ZONES*2, gpuQueries[i]);
+	}
+	gpuTimers = false;
+	enabled = false;
+}
+
+double Profiler::now()
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - profileEpoch).count();
+}
+
+void Profiler::record(const char* name, double start, double duration, int track)
+{
+	unsigned int slot = head.fetch_add(1, memory_order_relaxed) & (PROFILE_MAX_EVENTS - 1);
+	events[slot].name = name;
+	events[slot].start = start;
+	events[slot].duration = duration;
+	events[slot].track = track;
+}
+
+//Returns the zone to hand to gpuEnd(), or -1 if this frame is out of queries
+int Profiler::gpuBegin(const char* name)
+{
+	if(!gpuTimers || gpuCount[gpuFrame] == PROFILE_GPU_ZONES)
+		return -1;
+
+	int zone = gpuCount[gpuFrame]++;
+	gpuNames[gpuFrame][zone] = name;
+	glQueryCounter(gpuQueries[gpuFrame][zone*2], GL_TIMESTAMP);
+	return zone;
+}
+
+void Profiler::gpuEnd(int zone)
+{
+	glQueryCounter(gpuQueries[gpuFrame][zone*2 + 1], GL_TIMESTAMP);
+}
+
+//Collects the oldest frame's GPU zones and reuses its queries for the next
+//	Zones whose results still aren't in are dropped rather than waited on
+void Profiler::endFrame()
+{
+	if(!gpuTimers)
+		return;
+
+	gpuFrame = (gpuFrame + 1) % PROFILE_GPU_FRAMES;
+
+	for(int zone=0; zone<gpuCount[gpuFrame]; zone++){
+		GLuint* pair = &gpuQueries[gpuFrame][zone*2];
+		GLint available = 0;
+		glGetQueryObjectiv(pair[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+			continue;
+
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(pair[0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(pair[1], GL_QUERY_RESULT, &end);
+		record(gpuNames[gpuFrame][zone], begin*1e-9 + gpuOffset, (end - begin)*1e-9, PROFILE_GPU_TRACK);
+	}
+	gpuCount[gpuFrame] = 0;
+}
+
+bool Profiler::writeTrace(const char* filename)
+{
+	FILE* file = fopen(filename, "w");
+	if(file == 0){
+		printf("Profiler: could not write %s\n", filename);
+		return false;
+	}
+
+	unsigned int end = head.load(memory_order_acquire);
+	unsigned int begin = (end > PROFILE_MAX_EVENTS) ? end - PROFILE_MAX_EVENTS : 0;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}},\n", PROFILE_GPU_TRACK);
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Main\"}}", PROFILE_GPU_TRACK + 1);
+	for(unsigned int i=begin; i<end; i++){
+		const ProfileEvent& event = events[i & (PROFILE_MAX_EVENTS - 1)];
+		fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, event.track, event.start*1e6, event.duration*1e6);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	printf("Profiler: wrote %u events to %s\n", end - begin, filename);
+	return true;
+}
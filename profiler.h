@@ -0,0 +1,125 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include "alloctracker.h"
+
+#define PROFILE_MAX_EVENTS 65536	//Power of two; the oldest events are overwritten
+#define PROFILE_GPU_FRAMES 4		//Frames a GPU result may take to come back
+#define PROFILE_GPU_ZONES 32		//GPU zones per frame
+#define PROFILE_GPU_TRACK 0			//Trace thread id of the GPU timeline
+
+//Name must be a string literal, only the pointer is kept
+struct ProfileEvent{
+	const char* name;
+	double start;			//Seconds since the profiler started
+	double duration;
+	int track;
+};
+
+/*
+	Collects timed zones into a fixed ring that any thread can append to
+	without locking, and dumps them as Chrome trace_event JSON for
+	chrome://tracing or Perfetto.
+
+	GPU zones are GL_TIMESTAMP query pairs rather than GL_TIME_ELAPSED, so
+	they nest and don't collide with other elapsed-time queries. Results are
+	read PROFILE_GPU_FRAMES frames later without waiting, and mapped onto the
+	CPU clock with an offset taken when profiling starts.
+*/
+class Profiler{
+public:
+	bool enabled;
+	ProfileEvent events[PROFILE_MAX_EVENTS];
+	std::atomic<unsigned int> head;
+
+	bool gpuTimers;
+	double gpuOffset;			//CPU seconds minus GPU seconds
+	GLuint gpuQueries[PROFILE_GPU_FRAMES][PROFILE_GPU_ZONES*2];
+	const char* gpuNames[PROFILE_GPU_FRAMES][PROFILE_GPU_ZONES];
+	int gpuCount[PROFILE_GPU_FRAMES];
+	int gpuFrame;
+
+	Profiler();
+
+	void init(bool gpu);
+	void destroy();
+
+	double now();
+	void record(const char* name, double start, double duration, int track);
+
+	int gpuBegin(const char* name);
+	void gpuEnd(int zone);
+	void endFrame();
+
+	bool writeTrace(const char* filename);
+};
+
+extern Profiler profiler;
+
+int profileTrack();
+
+//Times its enclosing scope; one predictable branch when profiling is off
+//	With TRACK_ALLOCATIONS it also names the subsystem allocations are charged to
+class ProfileZone{
+public:
+	const char* name;
+	double start;
+#ifdef TRACK_ALLOCATIONS
+	const char* outerZone;
+#endif
+
+	ProfileZone(const char* _name): name(_name), start(-1.0)
+	{
+		if(profiler.enabled)
+			start = profiler.now();
+#ifdef TRACK_ALLOCATIONS
+		outerZone = allocationZone;
+		allocationZone = name;
+#endif
+	}
+
+	~ProfileZone()
+	{
+		if(start >= 0.0)
+			profiler.record(name, start, profiler.now() - start, profileTrack());
+#ifdef TRACK_ALLOCATIONS
+		allocationZone = outerZone;
+#endif
+	}
+};
+
+class GPUProfileZone{
+public:
+	int zone;
+
+	GPUProfileZone(const char* name): zone(-1)
+	{
+		if(profiler.enabled)
+			zone = profiler.gpuBegin(name);
+	}
+
+	~GPUProfileZone()
+	{
+		if(zone >= 0)
+			profiler.gpuEnd(zone);
+	}
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+#ifdef NO_PROFILER
+#define PROFILE_ZONE(name)
+#define PROFILE_GPU_ZONE(name)
+#else
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) GPUProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)(name)
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+#include "rendertarget.h"
+#include <iostream>
+
+using namespace std;
+
+RenderTarget::RenderTarget():	framebuffer(0),
+								colorBuffer(0),
+								depthBuffer(0),
+								depthFormat(GL_DEPTH_COMPONENT24),
+								width(0),
+								height(0),
+								viewWidth(0),
+								viewHeight(0)
+{}
+
+bool RenderTarget::init(int _width, int _height, GLenum _depthFormat)
+{
+	depthFormat = _depthFormat;
+
+	glGenFramebuffers(1, &framebuffer);
+	glGenRenderbuffers(1, &colorBuffer);
+	glGenRenderbuffers(1, &depthBuffer);
+
+	width = height = 0;
+	return resize(_width, _height);
+}
+
+//Reallocates storage only when the size actually changes
+bool RenderTarget::resize(int _width, int _height)
+{
+	if(_width == width && _height == height)
+		return true;
+	width = (_width > 0) ? _width : 1;
+	height = (_height > 0) ? _height : 1;
+	viewWidth = width;
+	viewHeight = height;
+
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, depthFormat, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if(status != GL_FRAMEBUFFER_COMPLETE){
+		cout << "RenderTarget: framebuffer incomplete (0x" << hex << status << dec << ")" << endl;
+		return false;
+	}
+	return true;
+}
+
+//Restricts bind() and blitToScreen() to the lower-left corner of the storage
+void RenderTarget::setViewSize(int _viewWidth, int _viewHeight)
+{
+	viewWidth = (_viewWidth < 1) ? 1 : (_viewWidth > width) ? width : _viewWidth;
+	viewHeight = (_viewHeight < 1) ? 1 : (_viewHeight > height) ? height : _viewHeight;
+}
+
+void RenderTarget::destroy()
+{
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	framebuffer = colorBuffer = depthBuffer = 0;
+	width = height = 0;
+	viewWidth = viewHeight = 0;
+}
+
+void RenderTarget::bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, viewWidth, viewHeight);
+}
+
+//Copies the colour buffer to the screen framebuffer (0 for the window's back
+//buffer), scaling if sizes differ, and leaves the screen bound
+void RenderTarget::blitToScreen(GLuint screen, int screenWidth, int screenHeight, GLenum filter)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, screen);
+	glBlitFramebuffer(0, 0, viewWidth, viewHeight, 0, 0, screenWidth, screenHeight, GL_COLOR_BUFFER_BIT, filter);
+	glBindFramebuffer(GL_FRAMEBUFFER, screen);
+}
@@ -0,0 +1,33 @@
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+//Offscreen colour + depth framebuffer, blitted to the window once per frame
+//	Rendering can be limited to a smaller view rectangle without reallocating
+class RenderTarget{
+public:
+	GLuint framebuffer;
+	GLuint colorBuffer;
+	GLuint depthBuffer;
+	GLenum depthFormat;
+	int width;
+	int height;
+	int viewWidth;
+	int viewHeight;
+
+	RenderTarget();
+
+	bool init(int _width, int _height, GLenum _depthFormat);
+	bool resize(int _width, int _height);
+	void setViewSize(int _viewWidth, int _viewHeight);
+	void destroy();
+
+	void bind();
+	void blitToScreen(GLuint screen, int screenWidth, int screenHeight, GLenum filter);
+};
+
+#endif
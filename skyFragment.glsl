@@ -0,0 +1,34 @@
+// ==========================================================================
+// Fragment program for the star background
+//
+// Looks up the equirectangular star map by view direction, using the same
+// (theta, phi) parameterization generateSphere() gave the old star sphere.
+// ==========================================================================
+#version 410
+
+out vec4 FragmentColour;
+
+in vec3 ViewRay;
+
+uniform sampler2D sphereTex;
+
+layout(std140) uniform FrameBlock
+{
+	mat4 cameraMatrix;
+	mat4 perspectiveMatrix;
+	mat4 skyMatrix;		// view rotation, undone, then the stars' own spin undone
+	vec4 lightPosition;
+	float farDepth;
+};
+
+#define PI 3.14159265359
+
+void main(void)
+{
+	vec3 dir = normalize(mat3(skyMatrix)*ViewRay);
+
+	float theta = atan(dir.y, dir.x)/(2.f*PI);
+	float phi = acos(clamp(dir.z, -1.f, 1.f))/PI;
+
+	FragmentColour = texture(sphereTex, vec2(fract(theta), phi));
+}
@@ -0,0 +1,29 @@
+// ==========================================================================
+// Vertex program for the star background
+//
+// One triangle covering the screen, generated from gl_VertexID with no
+// vertex buffers, placed on the far plane.
+// ==========================================================================
+#version 410
+
+out vec3 ViewRay;
+
+// shared with vertex.glsl, written once per frame into the streaming ring
+layout(std140) uniform FrameBlock
+{
+	mat4 cameraMatrix;
+	mat4 perspectiveMatrix;
+	mat4 skyMatrix;
+	vec4 lightPosition;
+	float farDepth;
+};
+
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2)*2.f - 1.f;
+
+	// view-space ray through this corner, linear across the screen
+	ViewRay = vec3(corner.x/perspectiveMatrix[0][0], corner.y/perspectiveMatrix[1][1], -1.f);
+
+	gl_Position = vec4(corner, farDepth, 1.f);
+}
@@ -0,0 +1,128 @@
+#include "streambuffer.h"
+#include "glsupport.h"
+#include <iostream>
+
+using namespace std;
+
+StreamBuffer::StreamBuffer():	buffer(0),
+								target(GL_ARRAY_BUFFER),
+								regionSize(0),
+								alignment(1),
+								regionCount(0),
+								region(0),
+								head(0),
+								persistent(false),
+								mapped(0)
+{
+	for(int i=0; i<STREAM_MAX_REGIONS; i++)
+		fences[i] = 0;
+}
+
+bool StreamBuffer::init(GLenum _target, GLsizeiptr _regionSize, int _regionCount, GLsizeiptr _alignment)
+{
+	target = _target;
+	alignment = (_alignment > 0) ? _alignment : 1;
+	regionSize = ((_regionSize + alignment - 1) / alignment) * alignment;
+	regionCount = (_regionCount < STREAM_MAX_REGIONS) ? _regionCount : STREAM_MAX_REGIONS;
+	region = regionCount - 1;		//First beginFrame() wraps around to region 0
+	head = 0;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+
+	persistent = hasGLVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage");
+	if(persistent){
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, regionSize*regionCount, 0, flags);
+		mapped = (unsigned char*)glMapBufferRange(target, 0, regionSize*regionCount, flags);
+		if(mapped == 0){
+			cout << "StreamBuffer: persistent mapping failed, falling back to per-frame maps" << endl;
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(target, buffer);
+			persistent = false;
+		}
+	}
+	if(!persistent)
+		glBufferData(target, regionSize*regionCount, 0, GL_STREAM_DRAW);
+
+	glBindBuffer(target, 0);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void StreamBuffer::destroy()
+{
+	for(int i=0; i<STREAM_MAX_REGIONS; i++){
+		if(fences[i]){
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+
+	if(buffer){
+		if(mapped){
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			glBindBuffer(target, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+	buffer = 0;
+	mapped = 0;
+}
+
+//Moves to the next region, waiting only if the GPU is still reading it
+void StreamBuffer::beginFrame()
+{
+	region = (region + 1) % regionCount;
+	head = 0;
+
+	if(fences[region]){
+		GLenum status = glClientWaitSync(fences[region], 0, 0);
+		while(status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+
+	if(!persistent){
+		glBindBuffer(target, buffer);
+		mapped = (unsigned char*)glMapBufferRange(target, region*regionSize, regionSize,
+							GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		glBindBuffer(target, 0);
+	}
+}
+
+//Returns a write pointer into the current region and its byte offset in the
+//buffer, or 0 when the region is full
+void* StreamBuffer::allocate(GLsizeiptr size, GLintptr* offset)
+{
+	if(mapped == 0 || head + size > regionSize)
+		return 0;
+
+	GLsizeiptr start = head;
+	head = ((head + size + alignment - 1) / alignment) * alignment;
+
+	*offset = region*regionSize + start;
+	if(persistent)
+		return mapped + *offset;
+	return mapped + start;
+}
+
+//Makes this frame's writes visible; must happen before any draw that reads them
+void StreamBuffer::flush()
+{
+	if(!persistent && mapped){
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+		mapped = 0;
+	}
+}
+
+void StreamBuffer::endFrame()
+{
+	flush();
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,43 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#define STREAM_MAX_REGIONS 4
+
+/*
+	Ring of per-frame regions inside one buffer object.
+	With GL 4.4 / ARB_buffer_storage the buffer stays persistently mapped,
+	otherwise each region is mapped unsynchronized for the frame. A fence
+	guards every region so the CPU never writes memory the GPU still reads.
+
+	beginFrame() -> allocate()... -> flush() -> draws -> endFrame()
+*/
+class StreamBuffer{
+public:
+	GLuint buffer;
+	GLenum target;
+	GLsizeiptr regionSize;
+	GLsizeiptr alignment;
+	int regionCount;
+	int region;
+	GLsizeiptr head;
+	bool persistent;
+	unsigned char* mapped;
+	GLsync fences[STREAM_MAX_REGIONS];
+
+	StreamBuffer();
+
+	bool init(GLenum _target, GLsizeiptr _regionSize, int _regionCount, GLsizeiptr _alignment);
+	void destroy();
+
+	void beginFrame();
+	void* allocate(GLsizeiptr size, GLintptr* offset);
+	void flush();
+	void endFrame();
+};
+
+#endif
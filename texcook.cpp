@@ -0,0 +1,380 @@
+// ==========================================================================
+// Offline texture cooker
+//
+// A separate program from the renderer; no window or GL context needed.
+//    texcook [--format auto|bc1|bc3] [--threads N] image...
+// decodes each image with stb_image, builds a gamma-correct mip chain and
+// encodes every level to BC1 (opaque) or BC3 (with alpha), writing
+// name.ktx2 beside the source. The renderer picks that file up in place of
+// the original and uploads its blocks as they are, for as long as the
+// source's hash still matches the one recorded in it.
+// ==========================================================================
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "ktx.h"
+#include "texturecache.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+struct FORMAT{
+	enum {AUTO=0, BC1, BC3};
+};
+
+int threadCount = 0;		//--threads, 0 is one per hardware thread
+
+struct Image{
+	int width, height;
+	vector<unsigned char> pixels;		//RGBA
+};
+
+double seconds()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Runs body(begin, end) over [0, count), split evenly across the threads
+template<typename Body>
+void parallelFor(int count, Body body)
+{
+	int threads = (threadCount > 0) ? threadCount : (int)thread::hardware_concurrency();
+	if(threads > count)
+		threads = count;
+	if(threads < 1)
+		threads = 1;
+
+	vector<thread> workers;
+	for(int i = 1; i < threads; i++)
+		workers.push_back(thread(body, count*i/threads, count*(i + 1)/threads));
+	body(0, count/threads);
+	for(size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+float linearTable[256];		//sRGB byte to linear light
+
+void initTables()
+{
+	for(int i = 0; i < 256; i++){
+		float c = i/255.f;
+		linearTable[i] = (c <= 0.04045f) ? c/12.92f : pow((c + 0.055f)/1.055f, 2.4f);
+	}
+}
+
+unsigned char toSRGB(float linear)
+{
+	float c = (linear <= 0.0031308f) ? linear*12.92f : 1.055f*pow(linear, 1.f/2.4f) - 0.055f;
+	int v = (int)(c*255.f + 0.5f);
+	return (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+//Next mip level: each texel averages its (up to) 2x2 parents in linear
+//	light, so dark and bright detail don't drift darker down the chain
+Image downsample(const Image& source)
+{
+	Image level;
+	level.width = (source.width > 1) ? source.width/2 : 1;
+	level.height = (source.height > 1) ? source.height/2 : 1;
+	level.pixels.resize((size_t)level.width*level.height*4);
+
+	parallelFor(level.height, [&](int begin, int end){
+		for(int y = begin; y < end; y++){
+			int y0 = (2*y < source.height) ? 2*y : source.height - 1;
+			int y1 = (2*y + 1 < source.height) ? 2*y + 1 : y0;
+			for(int x = 0; x < level.width; x++){
+				int x0 = (2*x < source.width) ? 2*x : source.width - 1;
+				int x1 = (2*x + 1 < source.width) ? 2*x + 1 : x0;
+				const unsigned char* p[4] = {&source.pixels[((size_t)y0*source.width + x0)*4],
+											 &source.pixels[((size_t)y0*source.width + x1)*4],
+											 &source.pixels[((size_t)y1*source.width + x0)*4],
+											 &source.pixels[((size_t)y1*source.width + x1)*4]};
+				unsigned char* out = &level.pixels[((size_t)y*level.width + x)*4];
+				for(int c = 0; c < 3; c++)
+					out[c] = toSRGB((linearTable[p[0][c]] + linearTable[p[1][c]] + linearTable[p[2][c]] + linearTable[p[3][c]])*0.25f);
+				out[3] = (unsigned char)((p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2)/4);		//Coverage is linear already
+			}
+		}
+	});
+	return level;
+}
+
+//A 4x4 block as RGBA, repeating the edge texels past the image border
+void loadBlock(const Image& image, int bx, int by, unsigned char block[64])
+{
+	for(int y = 0; y < 4; y++){
+		int sy = (by*4 + y < image.height) ? by*4 + y : image.height - 1;
+		for(int x = 0; x < 4; x++){
+			int sx = (bx*4 + x < image.width) ? bx*4 + x : image.width - 1;
+			memcpy(block + (y*4 + x)*4, &image.pixels[((size_t)sy*image.width + sx)*4], 4);
+		}
+	}
+}
+
+//Per-channel minimum and maximum of the block's 16 texels
+void blockBounds(const unsigned char block[64], unsigned char low[4], unsigned char high[4])
+{
+#ifdef __SSE2__
+	__m128i a = _mm_loadu_si128((const __m128i*)block);
+	__m128i b = _mm_loadu_si128((const __m128i*)(block + 16));
+	__m128i c = _mm_loadu_si128((const __m128i*)(block + 32));
+	__m128i d = _mm_loadu_si128((const __m128i*)(block + 48));
+	__m128i lo = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+	__m128i hi = _mm_max_epu8(_mm_max_epu8(a, b), _mm_max_epu8(c, d));
+	lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+	hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+	lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+	hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+	int l = _mm_cvtsi128_si32(lo), h = _mm_cvtsi128_si32(hi);
+	memcpy(low, &l, 4);
+	memcpy(high, &h, 4);
+#else
+	memcpy(low, block, 4);
+	memcpy(high, block, 4);
+	for(int i = 1; i < 16; i++){
+		for(int c = 0; c < 4; c++){
+			unsigned char v = block[i*4 + c];
+			low[c] = (v < low[c]) ? v : low[c];
+			high[c] = (v > high[c]) ? v : high[c];
+		}
+	}
+#endif
+}
+
+unsigned short pack565(const unsigned char* c)
+{
+	return (unsigned short)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+void unpack565(unsigned short v, int* c)
+{
+	int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+//Endpoints from the block's bounding box, pulled in by 1/16 of its extent so
+//	the interpolated colours land nearer the texels (van Waveren's real-time DXT)
+void encodeColour(const unsigned char block[64], const unsigned char* low, const unsigned char* high, unsigned char* out)
+{
+	unsigned char lo[3], hi[3];
+	for(int c = 0; c < 3; c++){
+		int inset = (high[c] - low[c]) >> 4;
+		lo[c] = low[c] + inset;
+		hi[c] = high[c] - inset;
+	}
+	unsigned short c0 = pack565(hi), c1 = pack565(lo);		//c0 >= c1: every channel of hi is >= lo
+
+	int palette[4][3];
+	unpack565(c0, palette[0]);
+	unpack565(c1, palette[1]);
+	for(int c = 0; c < 3; c++){
+		palette[2][c] = (2*palette[0][c] + palette[1][c])/3;
+		palette[3][c] = (palette[0][c] + 2*palette[1][c])/3;
+	}
+
+	unsigned int indices = 0;
+	if(c0 != c1){		//Equal endpoints select the three-colour mode; index 0 is right for it
+		for(int i = 0; i < 16; i++){
+			int best = 0, bestError = 1 << 30;
+			for(int p = 0; p < 4; p++){
+				int dr = block[i*4] - palette[p][0], dg = block[i*4 + 1] - palette[p][1], db = block[i*4 + 2] - palette[p][2];
+				int error = dr*dr + dg*dg + db*db;
+				if(error < bestError){
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= best << (2*i);
+		}
+	}
+
+	out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+	for(int i = 0; i < 4; i++)
+		out[4 + i] = (indices >> (8*i)) & 0xFF;
+}
+
+//BC3's alpha half: eight interpolated levels between the inset extremes
+void encodeAlpha(const unsigned char block[64], unsigned char low, unsigned char high, unsigned char* out)
+{
+	int inset = (high - low) >> 5;
+	int a0 = high - inset, a1 = low + inset;
+
+	int palette[8] = {a0, a1};
+	for(int i = 1; i < 7; i++)
+		palette[i + 1] = ((7 - i)*a0 + i*a1)/7;
+
+	unsigned long long indices = 0;
+	if(a0 != a1){
+		for(int i = 0; i < 16; i++){
+			int best = 0, bestError = 256;
+			for(int p = 0; p < 8; p++){
+				int error = abs(block[i*4 + 3] - palette[p]);
+				if(error < bestError){
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= (unsigned long long)best << (3*i);
+		}
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for(int i = 0; i < 6; i++)
+		out[2 + i] = (indices >> (8*i)) & 0xFF;
+}
+
+vector<unsigned char> encodeLevel(const Image& level, bool alpha)
+{
+	int blocksX = (level.width + 3)/4, blocksY = (level.height + 3)/4;
+	int blockBytes = alpha ? 16 : 8;
+	vector<unsigned char> out((size_t)blocksX*blocksY*blockBytes);
+
+	parallelFor(blocksY, [&](int begin, int end){
+		unsigned char block[64], low[4], high[4];
+		for(int by = begin; by < end; by++){
+			for(int bx = 0; bx < blocksX; bx++){
+				unsigned char* dst = &out[((size_t)by*blocksX + bx)*blockBytes];
+				loadBlock(level, bx, by, block);
+				blockBounds(block, low, high);
+				if(alpha){
+					encodeAlpha(block, low[3], high[3], dst);
+					dst += 8;
+				}
+				encodeColour(block, low, high, dst);
+			}
+		}
+	});
+	return out;
+}
+
+string cookedName(const string& source)
+{
+	size_t dot = source.find_last_of('.');
+	size_t slash = source.find_last_of("/\\");
+	if(dot == string::npos || (slash != string::npos && dot < slash))
+		return source + ".ktx2";
+	return source.substr(0, dot) + ".ktx2";
+}
+
+//VRAM before is what the renderer uploads from the source: RGB8 or RGBA8, one level
+bool cook(const char* filename, int format, size_t* before, size_t* after)
+{
+	double start = seconds();
+	FILE* file = fopen(filename, "rb");
+	if(file == 0){
+		cout << filename << ": can't open" << endl;
+		return false;
+	}
+	vector<unsigned char> source;
+	unsigned char chunk[65536];
+	for(size_t n; (n = fread(chunk, 1, sizeof(chunk), file)) > 0;)
+		source.insert(source.end(), chunk, chunk + n);
+	fclose(file);
+	unsigned long long sourceKey = textureCacheKey(source.data(), source.size(), KTX_SOURCE_COMPONENTS);
+
+	int width, height, components;
+	if(!stbi_info_from_memory(source.data(), (int)source.size(), &width, &height, &components)){
+		cout << filename << ": " << stbi_failure_reason() << endl;
+		return false;
+	}
+	bool alpha = (format == FORMAT::AUTO) ? (components == 2 || components == 4) : (format == FORMAT::BC3);
+
+	Image image;
+	unsigned char* data = stbi_load_from_memory(source.data(), (int)source.size(), &image.width, &image.height, &components, 4);
+	if(data == 0){
+		cout << filename << ": " << stbi_failure_reason() << endl;
+		return false;
+	}
+	image.pixels.assign(data, data + (size_t)image.width*image.height*4);
+	stbi_image_free(data);
+	double decoded = seconds();
+
+	vector<Image> chain(1, image);
+	while((chain.back().width > 1 || chain.back().height > 1) && chain.size() < KTX_MAX_LEVELS)
+		chain.push_back(downsample(chain.back()));
+	double mipped = seconds();
+
+	int levels = (int)chain.size();
+	vector< vector<unsigned char> > blocks(levels);
+	const unsigned char* levelData[KTX_MAX_LEVELS];
+	size_t levelSize[KTX_MAX_LEVELS];
+	*after = 0;
+	for(int i = 0; i < levels; i++){
+		blocks[i] = encodeLevel(chain[i], alpha);
+		levelData[i] = &blocks[i][0];
+		levelSize[i] = blocks[i].size();
+		*after += levelSize[i];
+	}
+	double encoded = seconds();
+
+	string output = cookedName(filename);
+	unsigned int vkFormat = alpha ? KTX_FORMAT::BC3_UNORM : KTX_FORMAT::BC1_RGB_UNORM;
+	if(!writeKTX2(output.c_str(), vkFormat, width, height, levels, levelData, levelSize, sourceKey)){
+		cout << output << ": could not write" << endl;
+		return false;
+	}
+
+	*before = (size_t)width*height*((components == 2 || components == 4) ? 4 : 3);
+	printf("%-16s %5dx%-5d -> %s  %s, %2d levels  VRAM %8.1f KB -> %7.1f KB, saved %8.1f KB (%2.0f%%)\n",
+			filename, width, height, output.c_str(), alpha ? "BC3" : "BC1", levels,
+			*before/1024.0, *after/1024.0, ((double)*before - *after)/1024.0, 100.0*(1.0 - (double)*after / *before));
+	printf("%-16s decode %.1f ms, mips %.1f ms, encode %.1f ms\n", "",
+			(decoded - start)*1e3, (mipped - decoded)*1e3, (encoded - mipped)*1e3);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	int format = FORMAT::AUTO;
+	vector<const char*> files;
+	for(int i = 1; i < argc; i++){
+		string arg = argv[i];
+		if(arg == "--format" && i + 1 < argc){
+			string name = argv[++i];
+			format = (name == "bc1") ? FORMAT::BC1 : (name == "bc3") ? FORMAT::BC3 : FORMAT::AUTO;
+		}
+		else if(arg == "--threads" && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else
+			files.push_back(argv[i]);
+	}
+	if(files.empty()){
+		cout << "Usage: texcook [--format auto|bc1|bc3] [--threads N] image..." << endl;
+		return 1;
+	}
+
+	initTables();
+	size_t totalBefore = 0, totalAfter = 0;
+	bool ok = true;
+	for(size_t i = 0; i < files.size(); i++){
+		size_t before = 0, after = 0;
+		if(cook(files[i], format, &before, &after)){
+			totalBefore += before;
+			totalAfter += after;
+		}
+		else
+			ok = false;
+	}
+	if(files.size() > 1)
+		printf("Total VRAM %.1f KB -> %.1f KB, saved %.1f KB\n",
+				totalBefore/1024.0, totalAfter/1024.0, ((double)totalBefore - totalAfter)/1024.0);
+	return ok ? 0 : 1;
+}
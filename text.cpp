@@ -0,0 +1,186 @@
+#include "text.h"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+#define TEXT_ATLAS_SIZE 512
+
+TextRenderer::TextRenderer():	program(0),
+								screenSizeLocation(-1),
+								atlas(0),
+								vao(0),
+								lineHeight(0.f),
+								ascender(0.f),
+								vertexCount(0)
+{}
+
+//Rasterizes the font into the atlas; FreeType is not needed after this returns
+bool TextRenderer::init(GLuint _program, const char* fontFile, int pixelSize)
+{
+	program = _program;
+
+	FT_Library library;
+	FT_Face face;
+	if(FT_Init_FreeType(&library)){
+		cout << "TextRenderer: could not initialise FreeType" << endl;
+		return false;
+	}
+	if(FT_New_Face(library, fontFile, 0, &face)){
+		cout << "TextRenderer: could not load font " << fontFile << endl;
+		FT_Done_FreeType(library);
+		return false;
+	}
+	FT_Set_Pixel_Sizes(face, 0, pixelSize);
+	lineHeight = face->size->metrics.height/64.f;
+	ascender = face->size->metrics.ascender/64.f;
+
+	//Shelf packing, one pixel of padding so bilinear taps never bleed
+	vector<unsigned char> pixels(TEXT_ATLAS_SIZE*TEXT_ATLAS_SIZE, 0);
+	int penX = 1, penY = 1, rowHeight = 0;
+	for(int c = TEXT_FIRST_CHAR; c <= TEXT_LAST_CHAR; c++){
+		Glyph& glyph = glyphs[c - TEXT_FIRST_CHAR];
+		glyph = Glyph();
+		if(FT_Load_Char(face, c, FT_LOAD_RENDER))
+			continue;
+
+		FT_GlyphSlot slot = face->glyph;
+		int w = slot->bitmap.width;
+		int h = slot->bitmap.rows;
+		if(penX + w + 1 > TEXT_ATLAS_SIZE){
+			penX = 1;
+			penY += rowHeight + 1;
+			rowHeight = 0;
+		}
+		if(penY + h + 1 > TEXT_ATLAS_SIZE){
+			cout << "TextRenderer: glyphs don't fit the atlas at " << pixelSize << "px" << endl;
+			break;
+		}
+
+		for(int row = 0; row < h; row++)
+			memcpy(&pixels[(penY + row)*TEXT_ATLAS_SIZE + penX], slot->bitmap.buffer + row*slot->bitmap.pitch, w);
+
+		glyph.uv0 = vec2(penX, penY)/(float)TEXT_ATLAS_SIZE;
+		glyph.uv1 = vec2(penX + w, penY + h)/(float)TEXT_ATLAS_SIZE;
+		glyph.offset = vec2(slot->bitmap_left, -slot->bitmap_top);
+		glyph.size = vec2(w, h);
+		glyph.advance = slot->advance.x/64.f;
+
+		penX += w + 1;
+		if(h > rowHeight)
+			rowHeight = h;
+	}
+
+	FT_Done_Face(face);
+	FT_Done_FreeType(library);
+
+	glGenTextures(1, &atlas);
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, TEXT_ATLAS_SIZE, TEXT_ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, &pixels[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	//Vertex offsets stay multiples of the stride, so draws can use them as first
+	vertices.init(GL_ARRAY_BUFFER, TEXT_MAX_GLYPHS*6*sizeof(TextVertex), 3, sizeof(TextVertex));
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vertices.buffer);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, position));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, uv));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void*)offsetof(TextVertex, colour));
+	glEnableVertexAttribArray(2);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	screenSizeLocation = glGetUniformLocation(program, "screenSize");
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "glyphAtlas"), 0);
+	glUseProgram(0);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void TextRenderer::destroy()
+{
+	glDeleteTextures(1, &atlas);
+	glDeleteVertexArrays(1, &vao);
+	vertices.destroy();
+	atlas = vao = 0;
+}
+
+//Queues a line with its top-left corner at (x, y); returns the pen's final x
+float TextRenderer::print(float x, float y, const char* text, vec4 colour)
+{
+	unsigned char c[4] = {(unsigned char)(colour.r*255.f), (unsigned char)(colour.g*255.f),
+						  (unsigned char)(colour.b*255.f), (unsigned char)(colour.a*255.f)};
+	float baseline = y + ascender;
+
+	for(; *text; text++){
+		if(*text < TEXT_FIRST_CHAR || *text > TEXT_LAST_CHAR)
+			continue;
+		const Glyph& glyph = glyphs[*text - TEXT_FIRST_CHAR];
+
+		if(glyph.size.x > 0.f && vertexCount + 6 <= TEXT_MAX_GLYPHS*6){
+			vec2 p0 = vec2(x, baseline) + glyph.offset;
+			vec2 p1 = p0 + glyph.size;
+			TextVertex corners[4] = {
+				{p0, glyph.uv0, {c[0], c[1], c[2], c[3]}},
+				{vec2(p1.x, p0.y), vec2(glyph.uv1.x, glyph.uv0.y), {c[0], c[1], c[2], c[3]}},
+				{p1, glyph.uv1, {c[0], c[1], c[2], c[3]}},
+				{vec2(p0.x, p1.y), vec2(glyph.uv0.x, glyph.uv1.y), {c[0], c[1], c[2], c[3]}}};
+
+			TextVertex* quad = &quads[vertexCount];
+			quad[0] = corners[0]; quad[1] = corners[1]; quad[2] = corners[2];
+			quad[3] = corners[0]; quad[4] = corners[2]; quad[5] = corners[3];
+			vertexCount += 6;
+		}
+		x += glyph.advance;
+	}
+	return x;
+}
+
+//All text queued this frame in one draw, blended over whatever is bound
+void TextRenderer::draw(int screenWidth, int screenHeight)
+{
+	if(vertexCount == 0)
+		return;
+
+	vertices.beginFrame();
+	GLintptr offset;
+	void* data = vertices.allocate(vertexCount*sizeof(TextVertex), &offset);
+	if(data)
+		memcpy(data, quads, vertexCount*sizeof(TextVertex));
+	vertices.flush();
+
+	if(data){
+		glUseProgram(program);
+		glUniform2f(screenSizeLocation, (float)screenWidth, (float)screenHeight);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, atlas);
+		glBindVertexArray(vao);
+
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDrawArrays(GL_TRIANGLES, offset/sizeof(TextVertex), vertexCount);
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+
+		glBindVertexArray(0);
+	}
+
+	vertices.endFrame();
+	vertexCount = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#include "glm/glm.hpp"
+#include "streambuffer.h"
+
+using namespace glm;
+
+#define TEXT_FIRST_CHAR 32			//Printable ASCII only
+#define TEXT_LAST_CHAR 126
+#define TEXT_MAX_GLYPHS 1024		//Glyphs per frame
+
+struct Glyph{
+	vec2 uv0, uv1;			//Atlas corners
+	vec2 offset;			//Top-left corner relative to the pen on the baseline
+	vec2 size;				//Pixels
+	float advance;
+};
+
+struct TextVertex{
+	vec2 position;			//Window pixels, top-left origin
+	vec2 uv;
+	unsigned char colour[4];
+};
+
+/*
+	Printable ASCII rasterized once by FreeType into a single-channel atlas.
+	print() only appends quads on the CPU; draw() streams them through a
+	ring and issues one draw call for all text in the frame.
+
+	print()... -> draw()
+*/
+class TextRenderer{
+public:
+	GLuint program;
+	GLint screenSizeLocation;
+	GLuint atlas;
+	GLuint vao;
+	StreamBuffer vertices;
+	Glyph glyphs[TEXT_LAST_CHAR - TEXT_FIRST_CHAR + 1];
+	float lineHeight;
+	float ascender;
+	TextVertex quads[TEXT_MAX_GLYPHS*6];
+	int vertexCount;
+
+	TextRenderer();
+
+	bool init(GLuint _program, const char* fontFile, int pixelSize);
+	void destroy();
+
+	float print(float x, float y, const char* text, vec4 colour);
+	void draw(int screenWidth, int screenHeight);
+};
+
+#endif
@@ -0,0 +1,18 @@
+// ==========================================================================
+// Fragment program for on-screen text
+//
+// The glyph atlas holds coverage only; colour comes from the vertex.
+// ==========================================================================
+#version 410
+
+out vec4 FragmentColour;
+
+in vec2 FragUV;
+in vec4 FragColour;
+
+uniform sampler2D glyphAtlas;
+
+void main(void)
+{
+	FragmentColour = vec4(FragColour.rgb, FragColour.a*texture(glyphAtlas, FragUV).r);
+}
@@ -0,0 +1,24 @@
+// ==========================================================================
+// Vertex program for on-screen text
+//
+// Glyph quads arrive in window pixels with the origin at the top left.
+// ==========================================================================
+#version 410
+
+layout(location = 0) in vec2 VertexPosition;
+layout(location = 1) in vec2 VertexUV;
+layout(location = 2) in vec4 VertexColour;
+
+out vec2 FragUV;
+out vec4 FragColour;
+
+uniform vec2 screenSize;
+
+void main()
+{
+	FragUV = VertexUV;
+	FragColour = VertexColour;
+
+	vec2 ndc = VertexPosition/screenSize*2.f - 1.f;
+	gl_Position = vec4(ndc.x, -ndc.y, 0.f, 1.f);
+}
@@ -0,0 +1,160 @@
+#include "texturecache.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Native byte order: entries never leave the machine that wrote them
+struct CacheHeader{
+	char magic[8];
+	unsigned int version;
+	unsigned int width, height, components;
+	unsigned long long key;
+	double decodeSeconds;
+	unsigned long long pixelBytes;
+};
+
+static const char cacheMagic[8] = {'T', 'E', 'X', 'C', 'A', 'C', 'H', 'E'};
+
+//FNV-1a over the source bytes, then the parameters that change the output
+unsigned long long textureCacheKey(const unsigned char* source, size_t size, int components)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for(size_t i = 0; i < size; i++){
+		hash ^= source[i];
+		hash *= 1099511628211ULL;
+	}
+	int parameters[2] = {components, TEXTURE_CACHE_VERSION};
+	const unsigned char* p = (const unsigned char*)parameters;
+	for(size_t i = 0; i < sizeof(parameters); i++){
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static void entryPath(char* path, size_t length, const char* dir, unsigned long long key)
+{
+	snprintf(path, length, "%s/%016llx.raw", dir, key);
+}
+
+bool makeTextureCache(const char* dir)
+{
+#ifdef _WIN32
+	return _mkdir(dir) == 0 || errno == EEXIST;
+#else
+	return mkdir(dir, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+//Maps the entry read-only; anything that doesn't check out is a miss
+bool loadCachedTexture(const char* dir, unsigned long long key, CachedImage* image)
+{
+	char path[1024];
+	entryPath(path, sizeof(path), dir, key);
+	image->mapping = 0;
+
+#ifdef _WIN32
+	FILE* file = fopen(path, "rb");
+	if(file == 0)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	void* mapping = (size > TEXTURE_CACHE_HEADER) ? malloc(size) : 0;
+	bool read = mapping && fread(mapping, 1, size, file) == (size_t)size;
+	fclose(file);
+	if(!read){
+		free(mapping);
+		return false;
+	}
+#else
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat info;
+	long size = (fstat(fd, &info) == 0) ? (long)info.st_size : 0;
+	void* mapping = (size > TEXTURE_CACHE_HEADER) ? mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+	if(mapping == MAP_FAILED)
+		return false;
+#endif
+	image->mapping = mapping;
+	image->mappingSize = size;
+
+	CacheHeader header;
+	memcpy(&header, mapping, sizeof(header));
+	unsigned long long expected = (unsigned long long)header.width*header.height*header.components;
+	if(memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != TEXTURE_CACHE_VERSION
+		|| header.key != key || header.pixelBytes != expected
+		|| (unsigned long long)size < TEXTURE_CACHE_HEADER + expected){
+		releaseCachedTexture(image);
+		return false;
+	}
+
+	image->pixels = (unsigned char*)mapping + TEXTURE_CACHE_HEADER;
+	image->width = header.width;
+	image->height = header.height;
+	image->components = header.components;
+	image->decodeSeconds = header.decodeSeconds;
+	return true;
+}
+
+bool storeCachedTexture(const char* dir, unsigned long long key, const unsigned char* pixels,
+						int width, int height, int components, double decodeSeconds)
+{
+	char path[1024], temporary[1100];
+	entryPath(path, sizeof(path), dir, key);
+	snprintf(temporary, sizeof(temporary), "%s.%p.tmp", path, (const void*)pixels);		//Unique among writers in flight
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = TEXTURE_CACHE_VERSION;
+	header.width = width;
+	header.height = height;
+	header.components = components;
+	header.key = key;
+	header.decodeSeconds = decodeSeconds;
+	header.pixelBytes = (unsigned long long)width*height*components;
+
+	unsigned char block[TEXTURE_CACHE_HEADER] = {};
+	memcpy(block, &header, sizeof(header));
+
+	FILE* file = fopen(temporary, "wb");
+	if(file == 0)
+		return false;
+	bool ok = fwrite(block, 1, sizeof(block), file) == sizeof(block)
+			&& fwrite(pixels, 1, header.pixelBytes, file) == header.pixelBytes;
+	ok = (fclose(file) == 0) && ok;
+#ifdef _WIN32
+	remove(path);		//rename() won't replace an existing file here
+#endif
+	if(!ok || rename(temporary, path) != 0){
+		remove(temporary);
+		return false;
+	}
+	return true;
+}
+
+void releaseCachedTexture(CachedImage* image)
+{
+	if(image->mapping == 0)
+		return;
+#ifdef _WIN32
+	free(image->mapping);
+#else
+	munmap(image->mapping, image->mappingSize);
+#endif
+	image->mapping = 0;
+	image->pixels = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <cstddef>
+
+#define TEXTURE_CACHE_VERSION 1		//Bump whenever decoding changes, so old entries miss
+#define TEXTURE_CACHE_HEADER 64		//Pixels start this far into an entry
+
+//A decoded image mapped straight from its cache entry
+struct CachedImage{
+	unsigned char* pixels;		//Into the mapping
+	int width, height, components;
+	double decodeSeconds;		//What decoding the source cost when the entry was written
+	void* mapping;
+	size_t mappingSize;
+};
+
+/*
+	Decoded texels on disk, one raw file per image in a cache directory,
+	named after a hash of the source file's bytes and the decode parameters.
+	An edited source hashes differently and simply misses; stale entries are
+	never read again and can be deleted with the directory at any time.
+	Entries are written to a temporary name and renamed into place, so a
+	crash mid-write leaves nothing a later run would trust.
+*/
+unsigned long long textureCacheKey(const unsigned char* source, size_t size, int components);
+bool makeTextureCache(const char* dir);
+bool loadCachedTexture(const char* dir, unsigned long long key, CachedImage* image);
+bool storeCachedTexture(const char* dir, unsigned long long key, const unsigned char* pixels,
+						int width, int height, int components, double decodeSeconds);
+void releaseCachedTexture(CachedImage* image);
+
+#endif
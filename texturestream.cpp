@@ -0,0 +1,562 @@
+#include "texturestream.h"
+#include "framepacing.h"
+#include "profiler.h"
+#include "glsupport.h"
+#include "stb_image.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+//From EXT_texture_compression_s3tc, which the core headers leave out
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static GLenum textureFormat(const TextureJob& job)
+{
+	if(job.cooked)
+		return (job.ktx.vkFormat == KTX_FORMAT::BC3_UNORM) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	return (job.components == 4) ? GL_RGBA : GL_RGB;
+}
+
+static int levelDimension(int size, int level)
+{
+	return (size >> level) > 0 ? (size >> level) : 1;
+}
+
+static void textureParameters()
+{
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+//Box filter down to at most TEXTURE_PREVIEW_SIZE on the longest side
+static unsigned char* shrink(const unsigned char* pixels, int width, int height, int components,
+								int* previewWidth, int* previewHeight)
+{
+	int longest = (width > height) ? width : height;
+	int factor = (longest + TEXTURE_PREVIEW_SIZE - 1)/TEXTURE_PREVIEW_SIZE;
+	int w = (width/factor > 0) ? width/factor : 1;
+	int h = (height/factor > 0) ? height/factor : 1;
+	unsigned char* preview = (unsigned char*)malloc((size_t)w*h*components);
+	if(preview == 0)
+		return 0;
+
+	for(int y = 0; y < h; y++){
+		for(int x = 0; x < w; x++){
+			for(int c = 0; c < components; c++){
+				int sum = 0, count = 0;
+				for(int sy = y*factor; sy < (y + 1)*factor && sy < height; sy++){
+					for(int sx = x*factor; sx < (x + 1)*factor && sx < width; sx++){
+						sum += pixels[((size_t)sy*width + sx)*components + c];
+						count++;
+					}
+				}
+				preview[((size_t)y*w + x)*components + c] = (unsigned char)(sum/count);
+			}
+		}
+	}
+	*previewWidth = w;
+	*previewHeight = h;
+	return preview;
+}
+
+TextureStreamer::TextureStreamer():	stopping(false),
+									staged(false),
+									budget(TEXTURE_UPLOAD_BUDGET),
+									placeholder(0),
+									uploading(-1),
+									blockFormats(false),
+									cacheDir(0),
+									cacheHits(0),
+									cacheMisses(0),
+									cacheSaved(0.0)
+{
+	for(int i = 0; i < TEXTURE_STREAM_JOBS; i++){
+		jobs[i].state = TextureJob::FREE;
+		jobs[i].slot = 0;
+		jobs[i].superseded = false;
+		jobs[i].pixels = 0;
+		jobs[i].cooked = false;
+		jobs[i].cached.mapping = 0;
+		jobs[i].preview = 0;
+		jobs[i].texture = 0;
+	}
+}
+
+//Needs a current context. _budget is the most bytes update() hands GL per
+//frame; decoded images are cached under _cacheDir unless it is 0. False if
+//the upload ring failed: textures still stream, straight from client memory
+bool TextureStreamer::init(GLsizeiptr _budget, const char* _cacheDir)
+{
+	budget = (_budget > 0) ? _budget : TEXTURE_UPLOAD_BUDGET;
+	staged = staging.init(GL_PIXEL_UNPACK_BUFFER, budget, TEXTURE_STREAM_REGIONS, 4);
+	if(!staged){
+		staging.destroy();
+		while(glGetError() != GL_NO_ERROR);
+	}
+
+	unsigned char grey[3] = {128, 128, 128};
+	glGenTextures(1, &placeholder);
+	glBindTexture(GL_TEXTURE_2D, placeholder);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	textureParameters();
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	blockFormats = hasGLExtension("GL_EXT_texture_compression_s3tc");
+	cacheDir = _cacheDir;
+	if(cacheDir && !makeTextureCache(cacheDir)){
+		printf("TextureStreamer: can't use %s as the texture cache, decoding every time\n", cacheDir);
+		cacheDir = 0;
+	}
+	stopping = false;
+	for(int i = 0; i < TEXTURE_STREAM_WORKERS; i++)
+		workers[i] = thread(&TextureStreamer::decodeLoop, this);
+
+	return staged && glGetError() == GL_NO_ERROR;
+}
+
+//Textures already handed to their slots belong to the caller
+void TextureStreamer::destroy()
+{
+	{
+		lock_guard<mutex> hold(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(int i = 0; i < TEXTURE_STREAM_WORKERS; i++){
+		if(workers[i].joinable())
+			workers[i].join();
+	}
+
+	for(int i = 0; i < TEXTURE_STREAM_JOBS; i++){
+		if(jobs[i].texture)
+			glDeleteTextures(1, &jobs[i].texture);
+		clear(jobs[i]);
+	}
+	uploading = -1;
+	if(staged)
+		staging.destroy();
+	staged = false;
+	if(placeholder)
+		glDeleteTextures(1, &placeholder);
+	placeholder = 0;
+}
+
+//Queues filename for decoding. An empty slot gets the placeholder straight
+//away; a slot that already holds a texture keeps it until the new one lands.
+//Jobs finish out of order, so earlier ones for the same slot are dropped
+bool TextureStreamer::request(const char* filename, GLuint* slot)
+{
+	if(strlen(filename) >= TEXTURE_NAME_LENGTH){
+		printf("TextureStreamer: file name too long: %s\n", filename);
+		return false;
+	}
+
+	//Only this thread moves jobs out of FREE
+	TextureJob* job = 0;
+	for(int i = 0; i < TEXTURE_STREAM_JOBS && job == 0; i++){
+		if(jobs[i].state.load(memory_order_acquire) == TextureJob::FREE)
+			job = &jobs[i];
+	}
+	if(job == 0){
+		printf("TextureStreamer: more than %d textures in flight, dropped %s\n", TEXTURE_STREAM_JOBS, filename);
+		return false;
+	}
+
+	for(int i = 0; i < TEXTURE_STREAM_JOBS; i++){
+		if(jobs[i].state.load(memory_order_acquire) != TextureJob::FREE && jobs[i].slot == slot)
+			jobs[i].superseded = true;
+	}
+
+	strcpy(job->filename, filename);
+	job->slot = slot;
+	job->superseded = false;
+	job->level = 0;
+	job->row = 0;
+	job->uploadFrames = 0;
+	job->requested = clockSeconds();
+	if(*slot == 0)
+		*slot = placeholder;
+
+	{
+		lock_guard<mutex> hold(lock);
+		job->state = TextureJob::QUEUED;
+	}
+	wake.notify_one();
+	return true;
+}
+
+void TextureStreamer::decodeLoop()
+{
+	while(true){
+		TextureJob* job = 0;
+		{
+			unique_lock<mutex> hold(lock);
+			while(!stopping && job == 0){
+				for(int i = 0; i < TEXTURE_STREAM_JOBS && job == 0; i++){
+					if(jobs[i].state.load(memory_order_relaxed) == TextureJob::QUEUED)
+						job = &jobs[i];
+				}
+				if(job == 0)
+					wake.wait(hold);
+			}
+			if(stopping)
+				return;
+			job->state = TextureJob::DECODING;
+		}
+
+		double start = clockSeconds();
+		if(readCooked(*job)){
+			job->decodeSeconds = clockSeconds() - start;
+			job->state.store(TextureJob::DECODED, memory_order_release);
+			continue;
+		}
+
+		decode(*job);
+		job->decodeSeconds = clockSeconds() - start;
+		job->state.store(TextureJob::DECODED, memory_order_release);
+	}
+}
+
+static unsigned char* readFile(const char* filename, size_t* size)
+{
+	FILE* file = fopen(filename, "rb");
+	if(file == 0)
+		return 0;
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	unsigned char* data = (length > 0) ? (unsigned char*)malloc(length) : 0;
+	if(data && fread(data, 1, length, file) != (size_t)length){
+		free(data);
+		data = 0;
+	}
+	fclose(file);
+	*size = (size_t)length;
+	return data;
+}
+
+//The source is read once: hashed for the cache key and, on a miss, decoded
+//from memory. A hit maps the cached texels instead; building the preview
+//then faults the mapped pages in here rather than on the GL thread
+void TextureStreamer::decode(TextureJob& job)
+{
+	job.pixels = 0;
+	job.cooked = false;
+	job.cache = CACHE::OFF;
+	job.preview = 0;
+
+	size_t size = 0;
+	unsigned char* source = readFile(job.filename, &size);
+	int width = 0, height = 0, components = 0;
+	if(source == 0 || !stbi_info_from_memory(source, (int)size, &width, &height, &components)){
+		free(source);
+		return;
+	}
+	int wanted = (components == 4) ? 4 : 3;		//GL gets RGB or RGBA, as before
+
+	unsigned long long key = cacheDir ? textureCacheKey(source, size, wanted) : 0;
+	if(cacheDir && loadCachedTexture(cacheDir, key, &job.cached) && job.cached.components == wanted){
+		job.cache = CACHE::HIT;
+		job.pixels = job.cached.pixels;
+		width = job.cached.width;
+		height = job.cached.height;
+	}
+	else{
+		releaseCachedTexture(&job.cached);
+		double start = clockSeconds();
+		job.pixels = stbi_load_from_memory(source, (int)size, &width, &height, &components, wanted);
+		if(cacheDir && job.pixels){
+			job.cache = CACHE::MISS;
+			storeCachedTexture(cacheDir, key, job.pixels, width, height, wanted, clockSeconds() - start);
+		}
+	}
+	free(source);
+	if(job.pixels == 0)
+		return;
+
+	job.width = width;
+	job.height = height;
+	job.components = wanted;
+	job.ktx.levels = 1;
+	job.ktx.levelOffset[0] = 0;
+	job.ktx.levelSize[0] = (size_t)width*height*wanted;
+	job.preview = shrink(job.pixels, width, height, wanted, &job.previewWidth, &job.previewHeight);
+}
+
+//Loads name.ktx2 in place of name.jpg/.png when texcook has made one; any
+//file that fails the checks, or was cooked from an older version of the
+//source, is skipped and the source decoded instead
+bool TextureStreamer::readCooked(TextureJob& job)
+{
+	if(!blockFormats)
+		return false;
+
+	char path[TEXTURE_NAME_LENGTH + 8];
+	strcpy(path, job.filename);
+	char* dot = strrchr(path, '.');
+	char* slash = strrchr(path, '/');
+	if(dot == 0 || (slash && dot < slash))
+		dot = path + strlen(path);
+	strcpy(dot, ".ktx2");
+
+	FILE* file = fopen(path, "rb");
+	if(file == 0)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	unsigned char* data = (size > 0) ? (unsigned char*)malloc(size) : 0;
+	bool ok = data && fread(data, 1, size, file) == (size_t)size && parseKTX2(data, size, &job.ktx);
+	fclose(file);
+	if(!ok){
+		printf("TextureStreamer: %s is not a texture this build reads, using %s\n", path, job.filename);
+		free(data);
+		return false;
+	}
+
+	//Without the source there is nothing to compare against, so the file stands
+	size_t sourceSize = 0;
+	unsigned char* source = readFile(job.filename, &sourceSize);
+	bool stale = source && textureCacheKey(source, sourceSize, KTX_SOURCE_COMPONENTS) != job.ktx.sourceKey;
+	free(source);
+	if(stale){
+		printf("TextureStreamer: %s was cooked from a different %s, using the source; run texcook again\n", path, job.filename);
+		free(data);
+		return false;
+	}
+
+	job.pixels = data;
+	job.cooked = true;
+	job.width = job.ktx.width;
+	job.height = job.ktx.height;
+	job.components = (job.ktx.vkFormat == KTX_FORMAT::BC3_UNORM) ? 4 : 3;
+	job.preview = 0;
+	for(int i = 0; i < job.ktx.levels && job.preview == 0; i++){
+		job.previewWidth = levelDimension(job.width, i);
+		job.previewHeight = levelDimension(job.height, i);
+		if(job.previewWidth <= TEXTURE_PREVIEW_SIZE && job.previewHeight <= TEXTURE_PREVIEW_SIZE)
+			job.preview = data + job.ktx.levelOffset[i];		//Points into pixels, not owned
+	}
+	return true;
+}
+
+//Gives a slot still on the flat placeholder something recognisable to draw
+bool TextureStreamer::showPreview(TextureJob& job)
+{
+	if(job.preview == 0 || *job.slot != placeholder)
+		return false;
+
+	GLuint preview;
+	GLenum format = textureFormat(job);
+	glGenTextures(1, &preview);
+	glBindTexture(GL_TEXTURE_2D, preview);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if(job.cooked)
+		glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, job.previewWidth, job.previewHeight, 0,
+								(GLsizei)ktxLevelSize(job.previewWidth, job.previewHeight, job.ktx.blockBytes), job.preview);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, format, job.previewWidth, job.previewHeight, 0, format, GL_UNSIGNED_BYTE, job.preview);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	textureParameters();
+	glBindTexture(GL_TEXTURE_2D, 0);
+	*job.slot = preview;
+	return true;
+}
+
+//The last row is in: swap the slot over and drop whatever it showed before
+void TextureStreamer::land(TextureJob& job)
+{
+	GLuint previous = *job.slot;
+	*job.slot = job.texture;
+	if(previous && previous != placeholder)
+		glDeleteTextures(1, &previous);
+
+	if(job.cooked)
+		printf("Texture %s: %dx%d %s with %d levels, read in %.1f ms off-thread, uploaded over %d frames, ready %.1f ms after request\n",
+				job.filename, job.width, job.height, (job.components == 4) ? "BC3" : "BC1", job.ktx.levels,
+				job.decodeSeconds*1e3, job.uploadFrames, (clockSeconds() - job.requested)*1e3);
+	else if(job.cache == CACHE::HIT){
+		double saved = job.cached.decodeSeconds - job.decodeSeconds;
+		cacheHits++;
+		cacheSaved += saved;
+		printf("Texture %s: %dx%d cache hit, mapped in %.1f ms off-thread (saved %.1f ms), uploaded over %d frames, ready %.1f ms after request\n",
+				job.filename, job.width, job.height, job.decodeSeconds*1e3, saved*1e3, job.uploadFrames,
+				(clockSeconds() - job.requested)*1e3);
+	}
+	else{
+		cacheMisses += (job.cache == CACHE::MISS);
+		printf("Texture %s: %dx%d %sdecoded in %.1f ms off-thread, uploaded over %d frames, ready %.1f ms after request\n",
+				job.filename, job.width, job.height, (job.cache == CACHE::MISS) ? "cache miss, " : "",
+				job.decodeSeconds*1e3, job.uploadFrames, (clockSeconds() - job.requested)*1e3);
+	}
+	job.texture = 0;
+	clear(job);
+}
+
+void TextureStreamer::clear(TextureJob& job)
+{
+	if(job.cooked)
+		free(job.pixels);
+	else{
+		if(job.cached.mapping)
+			releaseCachedTexture(&job.cached);
+		else if(job.pixels)
+			stbi_image_free(job.pixels);
+		free(job.preview);
+	}
+	job.cooked = false;
+	job.pixels = 0;
+	job.preview = 0;
+	job.slot = 0;
+	job.superseded = false;
+	job.texture = 0;
+	job.state.store(TextureJob::FREE, memory_order_release);
+}
+
+//GL thread, once per frame: publishes previews of freshly decoded images and
+//uploads at most budget bytes of one full image. True when a slot changed
+bool TextureStreamer::update()
+{
+	PROFILE_ZONE("textures");
+	bool changed = false;
+
+	for(int i = 0; i < TEXTURE_STREAM_JOBS; i++){
+		TextureJob& job = jobs[i];
+		if(job.state.load(memory_order_acquire) != TextureJob::DECODED)
+			continue;
+		if(job.superseded){
+			clear(job);
+			continue;
+		}
+		if(job.pixels == 0){
+			printf("TextureStreamer: could not load %s\n", job.filename);
+			clear(job);
+			continue;
+		}
+		changed |= showPreview(job);
+		job.state = TextureJob::UPLOADING;
+	}
+
+	for(int i = 0; i < TEXTURE_STREAM_JOBS && uploading < 0; i++){
+		if(jobs[i].state.load(memory_order_relaxed) == TextureJob::UPLOADING)
+			uploading = i;
+	}
+	if(uploading < 0)
+		return changed;
+
+	TextureJob& job = jobs[uploading];
+	if(job.superseded){
+		if(job.texture)
+			glDeleteTextures(1, &job.texture);
+		clear(job);
+		uploading = -1;
+		return changed;
+	}
+	GLenum format = textureFormat(job);
+	if(job.texture == 0){
+		glGenTextures(1, &job.texture);
+		glBindTexture(GL_TEXTURE_2D, job.texture);
+		for(int i = 0; i < job.ktx.levels; i++){
+			int width = levelDimension(job.width, i), height = levelDimension(job.height, i);
+			if(job.cooked)
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, format, width, height, 0, (GLsizei)job.ktx.levelSize[i], 0);
+			else
+				glTexImage2D(GL_TEXTURE_2D, i, format, width, height, 0, format, GL_UNSIGNED_BYTE, 0);
+		}
+		textureParameters();
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, job.ktx.levels - 1);
+		if(job.ktx.levels > 1)
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return changed;		//Storage alone can cost a frame's worth on some drivers
+	}
+
+	//Block-compressed data goes up in rows of 4x4 blocks
+	int width = levelDimension(job.width, job.level), height = levelDimension(job.height, job.level);
+	int step = job.cooked ? 4 : 1;
+	GLsizeiptr rowBytes = job.cooked ? (GLsizeiptr)((width + 3)/4)*job.ktx.blockBytes : (GLsizeiptr)width*job.components;
+	int rows = (int)(budget/rowBytes);
+	if(rows < 1)
+		rows = 1;
+	if(rows > (height - job.row + step - 1)/step)
+		rows = (height - job.row + step - 1)/step;
+	int texelRows = (rows*step < height - job.row) ? rows*step : height - job.row;
+	GLsizeiptr bytes = rows*rowBytes;
+	const unsigned char* source = job.pixels + job.ktx.levelOffset[job.level] + (job.row/step)*rowBytes;
+
+	GLintptr offset = 0;
+	void* destination = 0;
+	if(staged){
+		staging.beginFrame();
+		destination = staging.allocate(bytes, &offset);
+		if(destination)
+			memcpy(destination, source, bytes);
+		staging.flush();
+	}
+
+	//Without the ring, or for a single row wider than the budget, straight from memory
+	const void* data = destination ? (const void*)offset : (const void*)source;
+	glBindTexture(GL_TEXTURE_2D, job.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if(destination)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+	if(job.cooked)
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.row, width, texelRows, format, (GLsizei)bytes, data);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.row, width, texelRows, format, GL_UNSIGNED_BYTE, data);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	if(staged)
+		staging.endFrame();
+
+	job.uploadFrames++;
+	job.row += texelRows;
+	if(job.row >= height){
+		job.row = 0;
+		job.level++;
+	}
+	if(job.level >= job.ktx.levels){
+		land(job);
+		uploading = -1;
+		changed = true;
+	}
+	return changed;
+}
+
+//Blocks until every requested texture has landed, for runs that must not
+//draw placeholders (headless output, benchmarks)
+void TextureStreamer::finish()
+{
+	while(!idle()){
+		update();
+		if(uploading < 0)
+			this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
+
+bool TextureStreamer::idle()
+{
+	for(int i = 0; i < TEXTURE_STREAM_JOBS; i++){
+		if(jobs[i].state.load(memory_order_acquire) != TextureJob::FREE)
+			return false;
+	}
+	return true;
+}
+
+void TextureStreamer::report()
+{
+	if(cacheDir == 0 || cacheHits + cacheMisses == 0)
+		return;
+	printf("Texture cache (%s): %d hits, %d misses, %.1f ms of decoding saved\n",
+			cacheDir, cacheHits, cacheMisses, cacheSaved*1e3);
+}
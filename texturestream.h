@@ -0,0 +1,104 @@
+#ifndef TEXTURESTREAM_H
+#define TEXTURESTREAM_H
+
+// specify that we want the OpenGL core profile before including GLFW headers
+#define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#include "streambuffer.h"
+#include "ktx.h"
+#include "texturecache.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define TEXTURE_STREAM_JOBS 16				//Textures in flight at once
+#define TEXTURE_STREAM_WORKERS 2			//Decode threads
+#define TEXTURE_STREAM_REGIONS 3			//Upload ring regions, one per frame in flight
+#define TEXTURE_UPLOAD_BUDGET (1024*1024)	//Default bytes uploaded per frame
+#define TEXTURE_PREVIEW_SIZE 64				//Longest side of the low-res placeholder
+#define TEXTURE_NAME_LENGTH 256
+
+struct CACHE{
+	enum{OFF=0, HIT, MISS};
+};
+
+struct TextureJob{
+	enum{FREE=0, QUEUED, DECODING, DECODED, UPLOADING};
+	std::atomic<int> state;
+
+	char filename[TEXTURE_NAME_LENGTH];
+	GLuint* slot;				//Where the drawing code reads the texture from
+	bool superseded;			//A later request wants the same slot; GL thread only
+
+	//Written by the worker before it publishes DECODED; 0 pixels is a failed decode
+	unsigned char* pixels;		//Decoded image, or the whole cooked file
+	int width, height, components;
+	bool cooked;				//pixels holds a KTX2 file of block-compressed mips
+	KTXImage ktx;
+	int cache;					//CACHE::, how the decoded pixels were found
+	CachedImage cached;			//Owns pixels on a hit
+	unsigned char* preview;
+	int previewWidth, previewHeight;
+	double decodeSeconds;
+
+	//GL thread only
+	GLuint texture;				//Full size, filled row by row
+	int level;					//Mip level being uploaded
+	int row;					//Next row of it to upload
+	int uploadFrames;
+	double requested;
+};
+
+/*
+	Loads textures without stalling the frame. Worker threads decode the
+	image and a box-filtered preview; the GL thread shows a flat grey
+	placeholder, then the preview, while update() copies the full image
+	through a fenced pixel-unpack ring a few rows at a time. Where texcook has
+	left a name.ktx2 beside the source and the context has S3TC, that file's
+	BC1/BC3 mip chain is read instead and uploaded as it is. The slot passed
+	to request() is swapped to the finished texture once its last row lands,
+	so nothing samples a half-uploaded image. Decoded images are kept in a
+	disk cache (texturecache.h) and mapped straight back on later runs.
+
+	request()... -> update() once per frame (or finish() to block)
+*/
+class TextureStreamer{
+public:
+	TextureJob jobs[TEXTURE_STREAM_JOBS];
+	std::thread workers[TEXTURE_STREAM_WORKERS];
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping;
+	StreamBuffer staging;
+	bool staged;				//Uploads go through staging; false if it couldn't be made
+	GLsizeiptr budget;
+	GLuint placeholder;
+	int uploading;				//Job whose rows are going up, -1 for none
+	bool blockFormats;			//S3TC available, so cooked textures are used
+	const char* cacheDir;		//0 when the decode cache is off
+	int cacheHits, cacheMisses;
+	double cacheSaved;			//Seconds of decoding the hits skipped
+
+	TextureStreamer();
+
+	bool init(GLsizeiptr _budget, const char* _cacheDir);
+	void destroy();
+
+	bool request(const char* filename, GLuint* slot);
+	bool update();
+	void finish();
+	bool idle();
+	void report();
+
+	void decodeLoop();
+	bool readCooked(TextureJob& job);
+	void decode(TextureJob& job);
+	bool showPreview(TextureJob& job);
+	void land(TextureJob& job);
+	void clear(TextureJob& job);
+};
+
+#endif
@@ -0,0 +1,252 @@
+#include "transform.h"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_SSE
+#endif
+
+//AVX2 is compiled per function with a target attribute and only called after
+//the CPU check, so the rest of the program keeps its baseline instruction set
+#if defined(TRANSFORM_SSE) && defined(__GNUC__)
+#include <immintrin.h>
+#define TRANSFORM_AVX2
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+void PointsSoA::resize(int count)
+{
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+}
+
+int PointsSoA::size() const
+{
+	return (int)x.size();
+}
+
+void PointsSoA::set(int i, vec3 p)
+{
+	x[i] = p.x;
+	y[i] = p.y;
+	z[i] = p.z;
+}
+
+vec3 PointsSoA::get(int i) const
+{
+	return vec3(x[i], y[i], z[i]);
+}
+
+int detectSIMD()
+{
+#if defined(TRANSFORM_AVX2)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SIMD::AVX2;
+#endif
+#ifdef TRANSFORM_SSE
+	return SIMD::SSE;
+#else
+	return SIMD::SCALAR;
+#endif
+}
+
+int simdLevel()
+{
+	static int level = detectSIMD();
+	return level;
+}
+
+const char* simdName(int level)
+{
+	const char* names[SIMD::COUNT] = {"scalar", "sse", "avx2"};
+	return names[level];
+}
+
+// --------------------------------------------------------------------------
+// Scalar, also the tail of the SIMD paths
+
+void rotateScalar(PointsSoA& points, vec3 center, const mat3& rotation, int begin)
+{
+	for(int i=begin; i<points.size(); i++)
+		points.set(i, (points.get(i) - center) * rotation + center);
+}
+
+void renormalizeScalar(PointsSoA& vectors, int begin)
+{
+	for(int i=begin; i<vectors.size(); i++)
+		vectors.set(i, normalize(vectors.get(i)));
+}
+
+// --------------------------------------------------------------------------
+// SSE, 4 points per iteration
+
+#ifdef TRANSFORM_SSE
+void rotateSSE(PointsSoA& points, vec3 center, const mat3& rotation)
+{
+	//Row-vector product: component j of the result is dot(p, rotation[j])
+	__m128 m[3][3];
+	for(int j=0; j<3; j++)
+		for(int k=0; k<3; k++)
+			m[j][k] = _mm_set1_ps(rotation[j][k]);
+	__m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+
+	//Raw pointers, so stores aren't assumed to alias the vectors' own members
+	float* x = points.x.data();
+	float* y = points.y.data();
+	float* z = points.z.data();
+	int count = points.size() & ~3;
+	for(int i=0; i<count; i+=4){
+		__m128 px = _mm_sub_ps(_mm_loadu_ps(&x[i]), cx);
+		__m128 py = _mm_sub_ps(_mm_loadu_ps(&y[i]), cy);
+		__m128 pz = _mm_sub_ps(_mm_loadu_ps(&z[i]), cz);
+
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m[0][0]), _mm_mul_ps(py, m[0][1])), _mm_mul_ps(pz, m[0][2]));
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m[1][0]), _mm_mul_ps(py, m[1][1])), _mm_mul_ps(pz, m[1][2]));
+		__m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m[2][0]), _mm_mul_ps(py, m[2][1])), _mm_mul_ps(pz, m[2][2]));
+
+		_mm_storeu_ps(&x[i], _mm_add_ps(rx, cx));
+		_mm_storeu_ps(&y[i], _mm_add_ps(ry, cy));
+		_mm_storeu_ps(&z[i], _mm_add_ps(rz, cz));
+	}
+	rotateScalar(points, center, rotation, count);
+}
+
+//rsqrt estimate plus one Newton-Raphson step, y' = y*(1.5 - 0.5*x*y*y):
+//about 23 bits, without a sqrt and a divide per vector
+void renormalizeSSE(PointsSoA& vectors)
+{
+	__m128 half = _mm_set1_ps(0.5f), threeHalves = _mm_set1_ps(1.5f);
+
+	float* x = vectors.x.data();
+	float* y = vectors.y.data();
+	float* z = vectors.z.data();
+	int count = vectors.size() & ~3;
+	for(int i=0; i<count; i+=4){
+		__m128 vx = _mm_loadu_ps(&x[i]);
+		__m128 vy = _mm_loadu_ps(&y[i]);
+		__m128 vz = _mm_loadu_ps(&z[i]);
+
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		__m128 inverse = _mm_rsqrt_ps(lengthSquared);
+		inverse = _mm_mul_ps(inverse, _mm_sub_ps(threeHalves,
+							_mm_mul_ps(_mm_mul_ps(half, lengthSquared), _mm_mul_ps(inverse, inverse))));
+
+		_mm_storeu_ps(&x[i], _mm_mul_ps(vx, inverse));
+		_mm_storeu_ps(&y[i], _mm_mul_ps(vy, inverse));
+		_mm_storeu_ps(&z[i], _mm_mul_ps(vz, inverse));
+	}
+	renormalizeScalar(vectors, count);
+}
+#endif
+
+// --------------------------------------------------------------------------
+// AVX2 + FMA, 8 points per iteration
+
+#ifdef TRANSFORM_AVX2
+TARGET_AVX2 void rotateAVX2(PointsSoA& points, vec3 center, const mat3& rotation)
+{
+	__m256 m[3][3];
+	for(int j=0; j<3; j++)
+		for(int k=0; k<3; k++)
+			m[j][k] = _mm256_set1_ps(rotation[j][k]);
+	__m256 cx = _mm256_set1_ps(center.x), cy = _mm256_set1_ps(center.y), cz = _mm256_set1_ps(center.z);
+
+	float* x = points.x.data();
+	float* y = points.y.data();
+	float* z = points.z.data();
+	int count = points.size() & ~7;
+	for(int i=0; i<count; i+=8){
+		__m256 px = _mm256_sub_ps(_mm256_loadu_ps(&x[i]), cx);
+		__m256 py = _mm256_sub_ps(_mm256_loadu_ps(&y[i]), cy);
+		__m256 pz = _mm256_sub_ps(_mm256_loadu_ps(&z[i]), cz);
+
+		//The centre is added back as the start of each FMA chain
+		__m256 rx = _mm256_fmadd_ps(pz, m[0][2], _mm256_fmadd_ps(py, m[0][1], _mm256_fmadd_ps(px, m[0][0], cx)));
+		__m256 ry = _mm256_fmadd_ps(pz, m[1][2], _mm256_fmadd_ps(py, m[1][1], _mm256_fmadd_ps(px, m[1][0], cy)));
+		__m256 rz = _mm256_fmadd_ps(pz, m[2][2], _mm256_fmadd_ps(py, m[2][1], _mm256_fmadd_ps(px, m[2][0], cz)));
+
+		_mm256_storeu_ps(&x[i], rx);
+		_mm256_storeu_ps(&y[i], ry);
+		_mm256_storeu_ps(&z[i], rz);
+	}
+	_mm256_zeroupper();		//The tail is legacy SSE code; avoid the transition penalty
+	rotateScalar(points, center, rotation, count);
+}
+
+TARGET_AVX2 void renormalizeAVX2(PointsSoA& vectors)
+{
+	__m256 half = _mm256_set1_ps(0.5f), threeHalves = _mm256_set1_ps(1.5f);
+
+	float* x = vectors.x.data();
+	float* y = vectors.y.data();
+	float* z = vectors.z.data();
+	int count = vectors.size() & ~7;
+	for(int i=0; i<count; i+=8){
+		__m256 vx = _mm256_loadu_ps(&x[i]);
+		__m256 vy = _mm256_loadu_ps(&y[i]);
+		__m256 vz = _mm256_loadu_ps(&z[i]);
+
+		__m256 lengthSquared = _mm256_fmadd_ps(vz, vz, _mm256_fmadd_ps(vy, vy, _mm256_mul_ps(vx, vx)));
+		__m256 inverse = _mm256_rsqrt_ps(lengthSquared);
+		inverse = _mm256_mul_ps(inverse, _mm256_fnmadd_ps(_mm256_mul_ps(half, lengthSquared),
+							_mm256_mul_ps(inverse, inverse), threeHalves));
+
+		_mm256_storeu_ps(&x[i], _mm256_mul_ps(vx, inverse));
+		_mm256_storeu_ps(&y[i], _mm256_mul_ps(vy, inverse));
+		_mm256_storeu_ps(&z[i], _mm256_mul_ps(vz, inverse));
+	}
+	_mm256_zeroupper();
+	renormalizeScalar(vectors, count);
+}
+#endif
+
+// --------------------------------------------------------------------------
+// Dispatch
+
+void rotatePoints(PointsSoA& points, vec3 center, const mat3& rotation, int level)
+{
+	switch(level){
+#ifdef TRANSFORM_AVX2
+		case SIMD::AVX2 :
+			rotateAVX2(points, center, rotation);
+			break;
+#endif
+#ifdef TRANSFORM_SSE
+		case SIMD::SSE :
+			rotateSSE(points, center, rotation);
+			break;
+#endif
+		default :
+			rotateScalar(points, center, rotation, 0);
+	}
+}
+
+void renormalize(PointsSoA& vectors, int level)
+{
+	switch(level){
+#ifdef TRANSFORM_AVX2
+		case SIMD::AVX2 :
+			renormalizeAVX2(vectors);
+			break;
+#endif
+#ifdef TRANSFORM_SSE
+		case SIMD::SSE :
+			renormalizeSSE(vectors);
+			break;
+#endif
+		default :
+			renormalizeScalar(vectors, 0);
+	}
+}
+
+void rotatePoints(PointsSoA& points, vec3 center, const mat3& rotation)
+{
+	rotatePoints(points, center, rotation, simdLevel());
+}
+
+void renormalize(PointsSoA& vectors)
+{
+	renormalize(vectors, simdLevel());
+}
@@ -0,0 +1,41 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <vector>
+#include "glm/glm.hpp"
+
+using namespace glm;
+
+//Instruction sets the batch kernels are built for, in order of preference
+struct SIMD{
+	enum {SCALAR=0, SSE, AVX2, COUNT};
+};
+
+/*
+	vec3s stored as three float arrays, so one SIMD register holds the same
+	component of 4 (SSE) or 8 (AVX2) points. Arrays needn't be padded; the
+	kernels finish any remainder with the scalar path.
+*/
+struct PointsSoA{
+	std::vector<float> x, y, z;
+
+	void resize(int count);
+	int size() const;
+	void set(int i, vec3 p);
+	vec3 get(int i) const;
+};
+
+//Best level this CPU and OS support, detected on first use
+int simdLevel();
+const char* simdName(int level);
+
+//p' = (p - center) * rotation + center, the row-vector convention orbit() uses
+void rotatePoints(PointsSoA& points, vec3 center, const mat3& rotation);
+//Scales every vector to unit length; zero vectors are not allowed
+void renormalize(PointsSoA& vectors);
+
+//A fixed level, for benchmarks and self-checks; must be <= simdLevel()
+void rotatePoints(PointsSoA& points, vec3 center, const mat3& rotation, int level);
+void renormalize(PointsSoA& vectors, int level);
+
+#endif
@@ -11,23 +11,46 @@
 layout(location = 0) in vec3 VertexPosition;
 layout(location = 1) in vec3 VertexNormal;
 layout(location = 2) in vec2 UV;
+// instanced 0, 1, 2... offset by each draw's baseInstance
+layout(location = 3) in int DrawID;
 
 out vec3 FragNormal;
 out vec2 FragUV;
 out vec4 worldPos;
+flat out int FragDiffuse;
 
-uniform mat4 cameraMatrix;
-uniform mat4 perspectiveMatrix;
-uniform mat4 modelviewMatrix = mat4(1.f);
+// uniforms are written by the CPU straight into the streaming ring
+layout(std140) uniform FrameBlock
+{
+	mat4 cameraMatrix;
+	mat4 perspectiveMatrix;
+	mat4 skyMatrix;
+	vec4 lightPosition;
+	float farDepth;
+};
+
+struct DrawData
+{
+	mat4 modelviewMatrix;
+	bool isDiffuse;
+};
+
+layout(std140) uniform DrawBlock
+{
+	DrawData draws[128];		// MAX_DRAWS in main.cpp
+};
 // output to be interpolated between vertices and passed to the fragment stage
 
 void main()
 {
+	mat4 modelviewMatrix = draws[DrawID].modelviewMatrix;
+
 	FragNormal = normalize(
 					(modelviewMatrix*vec4(VertexNormal, 0.f)).xyz
 				);
 
 	FragUV = UV;
+	FragDiffuse = int(draws[DrawID].isDiffuse);
 	worldPos = modelviewMatrix*vec4(VertexPosition, 1.0);
 
 	gl_Position = perspectiveMatrix*cameraMatrix*worldPos;